@@ -0,0 +1,127 @@
+#ifndef ASYNCMQTT_H
+#define ASYNCMQTT_H
+
+#include "Arduino.h"
+#include <atomic>
+#if defined(ESP32)
+#include <AsyncTCP.h>
+#else
+#include <ESPAsyncTCP.h>
+#endif
+
+#define MQTT_KEEPALIVE_TIME 15      // s without a packet to the broker before a ping
+#define MQTT_CONNECT_TIMEOUT 5000   // ms from connect() until the CONNACK
+#define MQTT_INFLIGHT 4             // QoS 1 messages waiting for their PUBACK
+#define MQTT_SEGMENT_SIZE 536       // TCP_MSS of lwIP: flush() sends the queue in writes of one segment
+
+// MQTT 3.1.1 client on the async TCP stack (AsyncTCP on ESP32, ESPAsyncTCP on ESP8266), with the calls of
+// PubSubClient that the sketch uses. Nothing blocks: connect() only starts the DNS lookup and the TCP handshake,
+// and the TCP task only parses the incoming packets into a queue and never sends. Everything else runs in loop():
+// - outgoing packets go to a bounded queue. A message that does not fit, after handing the queue to TCP, is refused
+//   as a whole. flush() passes the queue to TCP as far as its send buffer allows, one segment per send.
+// - a QoS 1 message takes an in-flight slot until its PUBACK, acknowledged() reports the PUBACKs in the order of
+//   the messages. The message itself is not kept: connect() starts a clean session, and the sketch publishes the
+//   unacknowledged messages again from its own copy, e.g. the offlineStore.
+// - loop() delivers the received messages to the callback and keeps the connection alive
+class asyncMqtt : public Print {
+  public:
+    // state(), the values of PubSubClient
+    static const int stateConnectionTimeout = -4;
+    static const int stateConnectionLost = -3;
+    static const int stateConnectFailed = -2;
+    static const int stateDisconnected = -1;
+    static const int stateConnected = 0;      // > 0: the return code of a refused CONNACK
+    static const int stateConnecting = 0x7f;  // not in PubSubClient: TCP or CONNACK pending
+
+  private:
+    AsyncClient client;
+    const char *domain;
+    uint16_t port;
+    void (*callback)(char *topic, uint8_t *payload, unsigned int length) = NULL;
+    std::atomic<int> _state;
+    unsigned long connectStart;
+    unsigned long lastOut;
+    volatile unsigned long lastIn;
+    volatile bool pingOutstanding = false;
+    bool pingSent;                  // the PINGREQ was handed to TCP at pingSentAt
+    unsigned long pingSentAt;
+    uint32_t pingEnd;               // sentBytes once the PINGREQ is sent
+    uint16_t nextPacketId = 1;
+    uint32_t sentBytes = 0;
+    uint32_t sentSegments = 0;
+
+    // outgoing queue, loop() only
+    uint8_t *outBuffer = NULL;
+    uint16_t outSize = 0;
+    uint16_t outHead = 0;
+    uint16_t outLength = 0;
+    uint32_t publishLeft = 0;       // payload bytes still expected by write() after beginPublish()
+    bool beginPacket(uint8_t header, uint32_t length);
+    void queue(const uint8_t *data, uint16_t length);
+    void queueWord(uint16_t word);
+    void queueString(const char *text);
+    uint16_t queueFree() { return outSize - outLength; }
+    uint16_t packetId();
+
+    // QoS 1 messages until acknowledged() reported their PUBACK, oldest first
+    struct inflightMessage
+    {
+      uint16_t packetId;            // 0: free
+      std::atomic<bool> acked;      // set by the TCP task
+    };
+    inflightMessage inflight[MQTT_INFLIGHT];
+    uint8_t inflightHead = 0;
+    uint8_t inflightCount = 0;
+
+    // incoming packets, parsed on the TCP task
+    uint8_t *rxBuffer = NULL;
+    uint16_t rxSize = 0;
+    enum { rxFixedHeader, rxRemainingLength, rxBody, rxBroken } rxStep = rxFixedHeader;
+    uint8_t rxHeader;
+    uint8_t rxShift;                // of the next byte of the remaining length field
+    uint32_t rxLength;              // remaining length of the packet being received
+    uint32_t rxIndex;               // bytes of it received, those beyond rxSize are dropped with the packet
+    void receive(const uint8_t *data, size_t length);
+    void handlePacket();
+
+    // received messages: topic length, payload length (2 bytes each, high first), topic, payload;
+    // written by the TCP task and read by loop()
+    uint8_t *inBuffer = NULL;
+    uint16_t inSize = 0;
+    std::atomic<uint16_t> inHead;
+    std::atomic<uint16_t> inTail;
+    uint8_t *message = NULL;        // the message handed to the callback, zero terminated topic
+    uint16_t inFree() { return inSize - 1 - (inHead - inTail + inSize) % inSize; }
+    uint8_t inByte(uint16_t index) { return inBuffer[index % inSize]; }
+
+    static uint8_t lengthField(uint32_t length, uint8_t *field);
+    friend struct asyncMqttTest;    // the broker stub of test/test_async_mqtt drives the loopback client
+
+  public:
+    asyncMqtt(const char *domain, uint16_t port);
+    void setServer(const char *domain, uint16_t port);
+    void setCallback(void (*callback)(char *topic, uint8_t *payload, unsigned int length));
+    bool setBufferSize(uint16_t size);          // largest incoming packet
+    bool setOutputBufferSize(uint16_t size);    // outgoing queue, at least the largest message
+    uint32_t getSentBytes() { return sentBytes; }
+    uint32_t getSentSegments() { return sentSegments; }
+
+    bool connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos,
+                 bool willRetain, const char *willMessage);
+    void disconnect();
+    bool connected();
+    int state();
+    uint8_t inflightMessages();
+    uint8_t acknowledged();
+
+    bool publish(const char *topic, const char *payload, bool retained = false);
+    bool beginPublish(const char *topic, unsigned int length, bool retained, uint8_t qos = 0);
+    virtual size_t write(uint8_t data);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    int endPublish();
+    bool subscribe(const char *topic);
+    bool loop();
+    virtual void flush();
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include <Arduino.h>
 #include <stdint.h>
 unsigned long uptime, seconds;
-bool holdingregisters = true;
+uint8_t holdingregisters = 0xff;  // inverters whose holding registers are read after their next input read, bit mask
 const char buildversion[]="v1.3.1Rahr";
 
 #ifdef ARDUINO_ESP32_DEV
@@ -2,13 +2,40 @@
 #define GROWATTINTERFACE_H
 
 #include "Arduino.h"
+#include "settings.h"                 // PUBLISH_MSGPACK
 #include <ModbusMaster.h>         // Modbus master library for ESP8266
 #include <SoftwareSerial.h>       // Leave the main serial line (USB) for debugging and flashing
+#include "growattRegisters.h"
+#include "jsonWriter.h"
+#if defined(MODBUS_LISTEN_ONLY) && !defined(MODBUS_SHARED_BUS)
+#define MODBUS_SHARED_BUS         // the listener follows the other master like on a shared bus
+#endif
+#ifdef MODBUS_SHARED_BUS
+#include "modbusSniffer.h"
+#endif
+#ifdef PUBLISH_MSGPACK
+#include <ArduinoJson.h>
+#endif
+
+#ifndef SLAVE_IDS
+#define SLAVE_IDS       { 1 }     // Default slave ID of Growatt
+#endif
+static constexpr uint8_t slaveIds[] = SLAVE_IDS;
+#define INVERTERS (sizeof(slaveIds) / sizeof(slaveIds[0]))
+static_assert(INVERTERS >= 1 && INVERTERS <= 8, "1 to 8 inverters, they are kept as bits of an uint8_t");
 
 
 class growattIF {
-#define SLAVE_ID        1         // Default slave ID of Growatt
 #define MODBUS_RATE     9600      // Modbus speed of Growatt, do not change
+#define MODBUS_RESPONSE_TIMEOUT 100 // ms until the first response byte, a silent inverter fails after this time
+#define MODBUS_REQUEST_GAP 10     // ms of bus idle time between two requests
+#define MODBUS_MAX_REQUEST_SIZE 64 // registers per request, limited by the response buffer of ModbusMaster (protocol: 125)
+#define MAX_REGISTER_REQUESTS 8   // requests per register read
+#define MODBUS_WINDOW_REQUESTS 4  // requests per Modbus update, due groups beyond are read on the next update
+#define WRITE_QUEUE_SIZE 8        // register writes waiting for the bus, see queueWrite()
+#define WRITE_BLOCK_SIZE 8        // registers of one multiple register write
+#define FOREIGN_RESPONSE_TIMEOUT 500 // ms the bus is left to the response to a request of the other master, see MODBUS_SHARED_BUS
+#define COLLISION_RETRIES 1       // requests of a read asked again after a broken response on a shared bus
 
   private:
     ModbusMaster growattInterface;
@@ -20,41 +47,139 @@ class growattIF {
     int PinMAX485_RX;
     int PinMAX485_TX;
     int setcounter = 0;
-    int overflow;
 
-    struct modbus_input_registers
+    struct modbus_statistics
+    {
+      uint32_t requests, crcErrors, timeouts, otherErrors;
+      uint32_t cpuTime;           // us spent in poll(), including the transmission of the requests
+      uint32_t foreignReads;      // responses to the other master on a shared bus, decoded into the register image
+    };
+
+    // Everything kept per inverter (slave ID) on the bus, see slaveIds
+    struct inverterState
+    {
+      uint16_t inputImage[REGISTER_IMAGE_SIZE];       // raw input registers as read from the inverter
+      uint16_t holdingImage[REGISTER_IMAGE_SIZE];     // raw holding registers as read from the inverter
+      int32_t modbusdata[INPUT_REGISTER_COUNT];       // decoded input registers, see inputRegisterMap
+      int32_t modbussettings[HOLDING_REGISTER_COUNT]; // decoded holding registers, see holdingRegisterMap
+      int32_t publisheddata[INPUT_REGISTER_COUNT];    // input registers as last published, see SelectInputChanges()
+      bool inputSelected[INPUT_REGISTER_COUNT];       // input registers written by InputRegistersToJson()
+      uint8_t groupAge[REGISTER_GROUPS];              // Modbus updates since the group was read
+      uint8_t foreignGroups;                          // groups read by the other master since the last update, bit mask
+      uint16_t groupReads[REGISTER_GROUPS];           // successful reads since the last statistics message
+      uint32_t statisticsStart;
+      struct modbus_statistics statistics;
+    };
+    inverterState inverters[INVERTERS];
+
+    struct registerRequest
     {
-      int status;
-      float solarpower, pv1voltage, pv1current, pv1power, pv2voltage, pv2current, pv2power, outputpower, gridfrequency, gridvoltage;
-      float energytoday, energytotal, totalworktime, pv1energytoday, pv1energytotal, pv2energytoday, pv2energytotal, opfullpower;
-      float tempinverter, tempipm, tempboost;
-      int ipf, realoppercent, deratingmode, faultcode, faultbitcode, warningbitcode;
+      uint16_t start;
+      uint8_t count;
     };
-    struct modbus_input_registers modbusdata;
+    registerRequest inputPlan[MAX_REGISTER_REQUESTS];     // planned for the due groups of each input read
+    registerRequest holdingPlan[MAX_REGISTER_REQUESTS];
+    uint8_t inputPlanSize = 0;
+    uint8_t holdingPlanSize = 0;
+    static uint8_t planRequests(const registerDescriptor *map, uint8_t count, uint8_t groups, registerRequest *plan);
+
+    // group scheduler, see beginReadInputRegisters()
+    uint8_t dueGroups(const inverterState &inverter);
+    uint8_t scheduleGroups(inverterState &inverter);
 
-    struct modbus_holding_registers
+    // register writes in the order they were queued, see queueWrite()
+    struct registerWrite
     {
-      int enable, safetyfuncen, maxoutputactivepp, maxoutputreactivepp, modul;
-      float  maxpower, voltnormal, startvoltage, gridvoltlowlimit, gridvolthighlimit, gridfreqlowlimit, gridfreqhighlimit, gridvoltlowconnlimit, gridvolthighconnlimit, gridfreqlowconnlimit, gridfreqhighconnlimit;
-      char firmware[7], controlfirmware[7];
-      char serial[11];
+      uint8_t inverter;
+      uint16_t reg;               // first register
+      uint8_t count;              // > 1: one multiple register write, verified by reading it back
+      uint16_t holdTime;          // ms of bus silence after the write; 0: replaced by a newer write to reg
+      uint16_t values[WRITE_BLOCK_SIZE];
     };
+    registerWrite writeQueue[WRITE_QUEUE_SIZE];
+    uint8_t writeHead = 0;
+    uint8_t writeCount = 0;
+    void pollWrite();
 
-    struct modbus_holding_registers modbussettings;
+    // running read or write job, see poll()
+    uint8_t jobInverter = 0;
+    bool jobHolding;
+    bool jobWriting = false;
+    bool jobVerifying = false;      // reading back a multiple register write
+    uint8_t jobGroups = 0;
+    uint8_t jobBlock = 0;
+    uint8_t jobRetries = 0;
+    uint8_t jobResult = 0;
+    uint32_t jobNextRequest = 0;
+    bool busIdle();
+    uint8_t beginJob(uint8_t inverter, bool holding);
+    void pollJob();
+    void countResult(uint8_t result);
+    void waitDone();
+#ifdef MODBUS_SHARED_BUS
+    Stream *port;
+    modbusSniffer sniffer;
+    uint8_t heardInput = 0;         // inverters whose input registers came with a response to the other master, bit mask
+    uint8_t heardHolding = 0;
+    struct decode_statistics
+    {
+      uint32_t decodes;
+      uint32_t decodeTime, decodeTimeMax;   // us from the end of a response on the line until its registers were decoded
+    } decodeStatistics = {};
+    uint32_t busStatisticsStart = 0;
+    void listen();
+#endif
+
+    static void decodeRegisters(const registerDescriptor *map, uint8_t count, const uint16_t *image, int32_t *values);
+    static int64_t fixedValue(const registerDescriptor &reg, int32_t value);
+    static uint8_t registersToJson(const registerDescriptor *map, uint8_t count, const uint16_t *image, const int32_t *values, const bool *selected, jsonWriter &writer);
+#ifdef PUBLISH_MSGPACK
+    static void registersToDocument(const registerDescriptor *map, uint8_t count, const int32_t *values, const bool *selected, JsonObject object);
+#endif
+    static bool outsideDeadband(const registerDescriptor &reg, int32_t value, int32_t published);
+    friend struct growattIFTest;    // the host tests of the JSON formatting, see test/test_json_writer
   public:
     growattIF(int _PinMAX485_RE_NEG, int _PinMAX485_DE, int _PinMAX485_RX, int _PinMAX485_TX);
     void initGrowatt();
-    uint8_t writeRegister(uint16_t reg, uint16_t message);
-    uint16_t readRegister(uint16_t reg);
-    uint8_t ReadInputRegisters();
-    void InputRegistersToJson(char* json);
-    uint8_t ReadHoldingRegisters();
-    void HoldingRegistersToJson(char* json);
+    void initGrowatt(Stream &port);
+    void initGrowatt(HardwareSerial &port);
+    void setTimeouts(uint16_t responseTimeout, uint16_t interCharTimeout);
+    uint16_t getResponseTimeout();
+    uint16_t getInterCharTimeout();
+    uint8_t beginReadInputRegisters(uint8_t inverter);
+    uint8_t beginReadHoldingRegisters(uint8_t inverter);
+    uint8_t queueWrite(uint8_t inverter, uint16_t reg, uint16_t value, uint16_t holdTime = 0);
+    uint8_t queueWrite(uint8_t inverter, uint16_t reg, const uint16_t *values, uint8_t count);
+    uint8_t writesQueued();
+    uint8_t beginWrite();
+    void poll();
+    bool done();
+    uint8_t result();
+    uint8_t inverter();
+    uint8_t ReadInputRegisters(uint8_t inverter);
+    void SelectInputSnapshot(uint8_t inverter);
+    uint8_t SelectInputChanges(uint8_t inverter);
+    void InputRegistersToJson(uint8_t inverter, jsonWriter &writer);
+    void InputSnapshot(uint8_t inverter, uint16_t *words);
+    static void InputSnapshotToJson(const uint16_t *words, jsonWriter &writer);
+#ifdef PUBLISH_MSGPACK
+    void InputRegistersToDocument(uint8_t inverter, JsonObject object);
+#endif
+    uint8_t ReadHoldingRegisters(uint8_t inverter);
+    void HoldingRegistersToJson(uint8_t inverter, jsonWriter &writer);
+    void StatisticsToJson(uint8_t inverter, char* json);
+#ifdef MODBUS_SHARED_BUS
+    uint8_t heard(bool holding);
+    void BusStatisticsToJson(char *json);
+#endif
     String sendModbusError(uint8_t result);
 
     // Error codes
     static const uint8_t Success    = 0x00;
-    //static const uint8_t Continue   = 0xFF;
+    static const uint8_t Pending    = ModbusMaster::ku8MBPending;
+    static const uint8_t QueueFull  = 0xE8;
+    static const uint8_t VerifyFailed = 0xE9;
+    static const uint8_t ListenOnly = 0xEA;
 
     // Growatt Holding registers
     static const uint8_t regOnOff           = 0;
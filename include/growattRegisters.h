@@ -0,0 +1,168 @@
+#ifndef GROWATTREGISTERS_H
+#define GROWATTREGISTERS_H
+
+#include <stdint.h>
+
+// Register map of the Growatt inverter (see "Growatt PV Inverter Modbus RS485 RTU Protocol").
+// Each row describes one published field; the rows are decoded by growattIF::decodeRegisters()
+// and published in table order. Adding a field is one more row.
+
+#define REGISTER_IMAGE_SIZE   128   // Register 0..127 are mirrored for input and holding registers
+
+enum registerFormat : uint8_t
+{
+  fmtNumber,      // numeric value, published as raw * multiplier * 10^-exponent with the given decimals
+  fmtAscii,       // width words of two ASCII characters each, published as string
+  fmtHex          // published as 4 digit hex string
+};
+
+// Register groups are read at their own rate, see registerGroups
+enum registerGroup : uint8_t
+{
+  grpLive,        // power, voltages and currents
+  grpDiag,        // temperatures, derating and fault codes
+  grpEnergy,      // energy counters
+  grpSettings,    // holding registers, read at start and on request
+  REGISTER_GROUPS
+};
+
+struct registerGroupConfig
+{
+  uint8_t divider;      // read every divider-th Modbus update (config.modbus_update_sec)
+  uint8_t priority;     // 0 is packed into a bus window first
+  const char *name;
+};
+
+static constexpr registerGroupConfig registerGroups[REGISTER_GROUPS] = {
+  { 1, 0, "live" },
+  { 3, 1, "diag" },
+  { 6, 2, "energy" },
+  { 1, 3, "settings" }
+};
+
+struct registerDescriptor
+{
+  uint16_t address;     // first register
+  uint8_t width;        // number of 16 bit registers, 2 = 32 bit value high word first
+  uint8_t multiplier;   // value = raw * multiplier * 10^-exponent, e.g. 1, 1 for 0.1 V and 5, 1 for 0.5 s
+  uint8_t exponent;
+  uint8_t decimals;     // decimals published in the JSON message
+  bool isSigned;        // raw value is two's complement
+  registerFormat format;
+  registerGroup group;
+  uint16_t deadband;    // raw counts a value may move before it is published again, see PUBLISH_CHANGES
+  uint8_t deadbandPercent; // or this percentage of the published value, whichever is larger
+  const char *name;     // JSON key
+};
+
+static constexpr registerDescriptor inputRegisterMap[] = {
+  //  Status and PV data
+  {   0, 1, 1, 0, 0, false, fmtNumber, grpLive,       0, 0, "status" },
+  {   1, 2, 1, 1, 1, false, fmtNumber, grpLive,      50, 2, "solarpower" },
+  {   3, 1, 1, 1, 1, false, fmtNumber, grpLive,      20, 0, "pv1voltage" },
+  {   4, 1, 1, 1, 1, false, fmtNumber, grpLive,       1, 0, "pv1current" },
+  {   5, 2, 1, 1, 1, false, fmtNumber, grpLive,      50, 2, "pv1power" },
+  {   7, 1, 1, 1, 1, false, fmtNumber, grpLive,      20, 0, "pv2voltage" },
+  {   8, 1, 1, 1, 1, false, fmtNumber, grpLive,       1, 0, "pv2current" },
+  {   9, 2, 1, 1, 1, false, fmtNumber, grpLive,      50, 2, "pv2power" },
+  // Output
+  {  35, 2, 1, 1, 1, false, fmtNumber, grpLive,      50, 2, "outputpower" },
+  {  37, 1, 1, 2, 2, false, fmtNumber, grpLive,       5, 0, "gridfrequency" },
+  {  38, 1, 1, 1, 1, false, fmtNumber, grpLive,      20, 0, "gridvoltage" },
+  // Energy
+  {  53, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "energytoday" },
+  {  55, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "energytotal" },
+  {  57, 2, 5, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "totalworktime" },
+  {  59, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "pv1energytoday" },
+  {  61, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "pv1energytotal" },
+  {  63, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "pv2energytoday" },
+  {  65, 2, 1, 1, 1, false, fmtNumber, grpEnergy,     0, 0, "pv2energytotal" },
+  { 102, 2, 1, 1, 1, false, fmtNumber, grpDiag,      50, 2, "opfullpower" },
+  // Temperatures
+  {  93, 1, 1, 1, 1, false, fmtNumber, grpDiag,      10, 0, "tempinverter" },
+  {  94, 1, 1, 1, 1, false, fmtNumber, grpDiag,      10, 0, "tempipm" },
+  {  95, 1, 1, 1, 1, false, fmtNumber, grpDiag,      10, 0, "tempboost" },
+  // Diag data
+  { 100, 1, 1, 0, 0, false, fmtNumber, grpDiag,     100, 0, "ipf" },
+  { 101, 1, 1, 0, 0, false, fmtNumber, grpDiag,       0, 0, "realoppercent" },
+  { 104, 1, 1, 0, 0, false, fmtNumber, grpDiag,       0, 0, "deratingmode" },
+  //  0:no derate; 1:PV; 2:*; 3:Vac; 4:Fac; 5:Tboost; 6:Tinv; 7:Control; 8:*; 9:*OverBackByTime
+  { 105, 1, 1, 0, 0, false, fmtNumber, grpDiag,       0, 0, "faultcode" },
+  //  1~23 Error: 99+x, 24 Auto Test, 25 No AC, 26 PV Isolation Low, 27 Residual I,
+  //  28 Output High, 29 PV Voltage, 30 AC V Outrange, 31 AC F Outrange, 32 Module Hot
+  { 106, 2, 1, 0, 0, false, fmtNumber, grpDiag,       0, 0, "faultbitcode" },
+  //  0x00000002 Communication error
+  //  0x00000008 StrReverse or StrShort fault
+  //  0x00000010 Model Init fault
+  //  0x00000020 Grid Volt Sample diffirent
+  //  0x00000040 ISO Sample diffirent
+  //  0x00000080 GFCI Sample diffirent
+  //  0x00001000 AFCI Fault
+  //  0x00004000 AFCI Module fault
+  //  0x00020000 Relay check fault
+  //  0x00200000 Communication error
+  //  0x00400000 Bus Voltage error
+  //  0x00800000 AutoTest fail
+  //  0x01000000 No Utility
+  //  0x02000000 PV Isolation Low
+  //  0x04000000 Residual I High
+  //  0x08000000 Output High DCI
+  //  0x10000000 PV Voltage high
+  //  0x20000000 AC V Outrange
+  //  0x40000000 AC F Outrange
+  //  0x80000000 TempratureHigh
+  { 110, 2, 1, 0, 0, false, fmtNumber, grpDiag,       0, 0, "warningbitcode" }
+  //  0x0001 Fan warning
+  //  0x0002 String communication abnormal
+  //  0x0004 StrPIDconfig Warning
+  //  0x0010 DSP and COM firmware unmatch
+  //  0x0040 SPD abnormal
+  //  0x0080 GND and N connect abnormal
+  //  0x0100 PV1 or PV2 circuit short
+  //  0x0200 PV1 or PV2 boost driver broken
+};
+
+static constexpr registerDescriptor holdingRegisterMap[] = {
+  {   0, 1, 1, 0, 0, false, fmtNumber, grpSettings,   0, 0, "enable" },
+  {   1, 1, 1, 0, 0, false, fmtNumber, grpSettings,   0, 0, "safetyfuncen" },
+  //  Bit0: SPI enable
+  //  Bit1: AutoTestStart
+  //  Bit2: LVFRT enable
+  //  Bit3: FreqDerating Enable
+  //  Bit4: Softstart enable
+  //  Bit5: DRMS enable
+  //  Bit6: Power Volt Func Enable
+  //  Bit7: HVFRT enable
+  //  Bit8: ROCOF enable
+  //  Bit9: Recover FreqDerating Mode Enable
+  //  Bit10~15: Reserved
+  {   3, 1, 1, 0, 0, false, fmtNumber, grpSettings,   0, 0, "maxoutputactivepp" },     // 0-100: %, 255: not limited
+  {   4, 1, 1, 0, 0, false, fmtNumber, grpSettings,   0, 0, "maxoutputreactivepp" },   // 0-100: %, 255: not limited
+  {   6, 2, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "maxpower" },
+  {   8, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "voltnormal" },
+  {  17, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "startvoltage" },
+  {  52, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "gridvoltlowlimit" },
+  {  53, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "gridvolthighlimit" },
+  {  54, 1, 1, 2, 1, false, fmtNumber, grpSettings,   0, 0, "gridfreqlowlimit" },
+  {  55, 1, 1, 2, 1, false, fmtNumber, grpSettings,   0, 0, "gridfreqhighlimit" },
+  {  64, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "gridvoltlowconnlimit" },
+  {  65, 1, 1, 1, 1, false, fmtNumber, grpSettings,   0, 0, "gridvolthighconnlimit" },
+  {  66, 1, 1, 2, 1, false, fmtNumber, grpSettings,   0, 0, "gridfreqlowconnlimit" },
+  {  67, 1, 1, 2, 1, false, fmtNumber, grpSettings,   0, 0, "gridfreqhighconnlimit" },
+  {   9, 3, 1, 0, 0, false, fmtAscii,  grpSettings,   0, 0, "firmware" },
+  {  12, 3, 1, 0, 0, false, fmtAscii,  grpSettings,   0, 0, "controlfirmware" },
+  {  23, 5, 1, 0, 0, false, fmtAscii,  grpSettings,   0, 0, "serial" },
+  { 121, 1, 1, 0, 0, false, fmtHex,    grpSettings,   0, 0, "modulPower" }
+};
+
+#define INPUT_REGISTER_COUNT   (sizeof(inputRegisterMap) / sizeof(inputRegisterMap[0]))
+#define HOLDING_REGISTER_COUNT (sizeof(holdingRegisterMap) / sizeof(holdingRegisterMap[0]))
+
+// Registers of the fields of the input map, the size of a snapshot packed by growattIF::InputSnapshot()
+static constexpr uint16_t inputSnapshotWords(uint8_t i = 0)
+{
+  return i < INPUT_REGISTER_COUNT ? inputRegisterMap[i].width + inputSnapshotWords(i + 1) : 0;
+}
+#define INPUT_SNAPSHOT_WORDS inputSnapshotWords()
+
+#endif
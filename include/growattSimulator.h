@@ -0,0 +1,70 @@
+#ifndef GROWATTSIMULATOR_H
+#define GROWATTSIMULATOR_H
+
+#include "Arduino.h"
+#include "growattRegisters.h"
+
+// Software Growatt slave. It is handed to ModbusMaster instead of the RS485 serial line and
+// answers the RTU requests (0x03, 0x04, 0x06, 0x10) from its own register image, so the
+// Modbus -> JSON -> MQTT path can be run and measured without an inverter. It answers for several
+// slave IDs with the same register image, like inverters of one type on a shared bus.
+// setDatalogger() adds the traffic of a second master, like the ShineWiFi datalogger, with the timing of
+// a 9600 baud line; a request sent while it is on the wire collides and is not answered.
+class growattSimulator : public Stream {
+  private:
+    static const uint16_t maxFrameSize = 256;            // RTU ADU limit
+    static const uint16_t characterTime = 1146;          // us of one character at 9600 baud, 11 bits
+    static const uint16_t turnaround = 30000;            // us until the inverter answers the datalogger
+    static const uint8_t dataloggerBlock = 45;           // input registers per datalogger request
+
+    const uint8_t *slaveIds;
+    uint8_t slaves;
+    uint8_t request[maxFrameSize];
+    uint16_t requestLength;
+    uint8_t response[maxFrameSize];
+    uint16_t responseLength;
+    uint16_t responseIndex;
+    uint32_t requests;
+    bool collided;                                       // the request being received crossed the datalogger
+
+    // the datalogger exchange on the wire: request, turnaround, response
+    uint16_t dataloggerPeriod;                           // ms, 0: no datalogger
+    uint32_t dataloggerNext;
+    uint16_t dataloggerStart;                            // first input register of the next request
+    uint8_t foreign[8 + 5 + 2 * dataloggerBlock];
+    uint16_t foreignLength;
+    uint16_t foreignRequestLength;
+    uint16_t foreignIndex;                               // bytes read
+    uint32_t foreignStart;                               // us
+    uint32_t exchangeEnd;                                // us, our last response was read
+    uint32_t collisions;
+
+    void processRequest();
+    void appendCRC();
+    void exceptionResponse(uint8_t function, uint8_t exception);
+    bool answers(uint8_t slaveId);
+    void updateLiveValues();
+    void pollDatalogger();
+    void startDatalogger();
+    uint16_t foreignOnWire();
+    bool foreignTalking();
+
+  public:
+    uint16_t inputRegisters[REGISTER_IMAGE_SIZE];
+    uint16_t holdingRegisters[REGISTER_IMAGE_SIZE];
+
+    growattSimulator(const uint8_t *_slaveIds, uint8_t _slaves);
+    uint32_t requestCount() { return requests; }
+    void setDatalogger(uint16_t period);
+    uint32_t collisionCount() { return collisions; }
+
+    // Stream
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t write(uint8_t data) override;
+    using Print::write;
+};
+
+#endif
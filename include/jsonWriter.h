@@ -0,0 +1,46 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Print.h>
+
+// Appends JSON text in place at a cursor, without rescanning the buffer and without printf.
+// The output is cut at the buffer size and stays zero terminated; overflow() tells if it was cut.
+// Without a buffer the text is only counted, or written to a Print such as the MQTT client. A Print gets
+// the text in chunks of JSON_CHUNK_SIZE, the last one with flush(); echo gets the same chunks, e.g. SerialDebug.
+#define JSON_CHUNK_SIZE 64
+class jsonWriter {
+  private:
+    char *cursor;
+    char *end;                // last usable byte, reserved for the terminator
+    Print *out;
+    Print *echo;
+    uint8_t chunk[JSON_CHUNK_SIZE];
+    uint8_t chunkLength;
+    size_t count;
+    bool truncated;
+
+    void put(char c);
+
+  public:
+    jsonWriter();                                             // counts the length only
+    jsonWriter(char *buffer, size_t size);
+    jsonWriter(Print &stream, Print *_echo = NULL);
+
+    void append(char c);
+    void append(const char *text);
+    void appendKey(const char *name);                         // "name":
+    void appendString(const char *text);                      // "text"
+    void appendUnsigned(uint32_t value);
+    void appendSigned(int32_t value);
+    void appendFixed(int64_t value, uint8_t decimals);        // value / 10^decimals, e.g. 1234, 1 -> 123.4
+    void appendHex(uint16_t value);                           // 4 upper case hex digits
+
+    void flush();                                             // writes the buffered chunk to the Print
+
+    size_t length() { return count; }
+    bool overflow() { return truncated; }
+};
+
+#endif
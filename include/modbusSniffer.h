@@ -0,0 +1,54 @@
+#ifndef MODBUSSNIFFER_H
+#define MODBUSSNIFFER_H
+
+#include "Arduino.h"
+
+// Follows the RTU frames of another master on the RS485 bus, e.g. the Growatt ShineWiFi datalogger.
+// Requests and responses are told apart by their length and CRC, so frames that were read together
+// in one loop() pass are still split right. A register read response that answers the request seen
+// before it is handed out by poll(), and idle() tells when the bus is free for a request of our own.
+class modbusSniffer {
+  private:
+    static const uint16_t maxFrameSize = 256;            // RTU ADU limit
+
+    uint8_t frame[maxFrameSize];
+    uint16_t length = 0;
+    uint16_t delivered = 0;         // size of the frame handed out by poll(), dropped on the next call
+    uint32_t lastByte = 0;          // us, arrival of the last byte
+    uint16_t frameSilence = 0;      // us, t3.5 ends a frame
+    uint16_t responseTimeout = 0;   // ms the bus is kept free for the response to a request
+
+    bool requestPending = false;    // a request was seen, its response not yet
+    uint32_t requestTime = 0;       // ms
+    uint8_t requestSlave;
+    uint8_t requestFunction;
+    uint16_t requestStart;
+    uint16_t requestCount;
+
+    uint16_t frameLength(bool *complete);
+    bool handleFrame(uint16_t size);
+    void drop(uint16_t size);
+
+  public:
+    void begin(uint16_t _frameSilence, uint16_t _responseTimeout);
+    bool poll(Stream &port);
+    bool idle(uint16_t gap);
+    void collision();
+
+    // The read transaction completed by the last poll() that returned true
+    uint8_t slave() { return requestSlave; }
+    uint8_t function() { return requestFunction; }
+    uint16_t start() { return requestStart; }
+    uint16_t count() { return requestCount; }
+    uint16_t value(uint8_t index) { return (frame[3 + 2 * index] << 8) | frame[4 + 2 * index]; }
+    uint32_t frameEnd() { return lastByte; }                // us, its last byte was taken from the line
+
+    // frames seen on the bus, cleared by the reader
+    struct sniffer_statistics
+    {
+      uint32_t requests, responses;
+      uint32_t brokenFrames;      // bytes that did not become a frame with a valid CRC, e.g. after a collision
+    } statistics = {};
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MQTTCOMMAND_H
+#define MQTTCOMMAND_H
+
+#include <stdint.h>
+
+// Payload types of the write/ and writeconfig/ commands
+enum commandArgument : uint8_t
+{
+  argOnOff,       // ON or OFF in any case, 1 or 0
+  argInteger,     // decimal integer, e.g. 100
+  argHex,         // 1 to 4 hex digits with optional 0x, e.g. 0F
+  argTenths,      // decimal number with up to one decimal, sent as value * 10, e.g. 80.5 -> 805
+  argPayload      // not parsed, the handler gets the payload and value is its length
+};
+
+// An incoming command, looked up by the topic suffix after "<topicRoot>/"
+struct mqttCommand
+{
+  const char *suffix;
+  commandArgument argument;
+  int32_t minimum, maximum;             // accepted range of the parsed value
+  uint16_t reg;                         // holding register written with the value when handler is NULL
+  uint8_t (*handler)(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length); // for other commands, returns a growattIF result code
+};
+
+// Parses the payload (not zero terminated) into value, false when it does not match the argument type.
+// Leading and trailing blanks are ignored.
+bool parseArgument(commandArgument argument, const uint8_t *payload, unsigned int length, int32_t *value);
+
+// Binary search in a command table sorted by suffix, NULL when the suffix is unknown
+const mqttCommand *findCommand(const mqttCommand *commands, uint8_t count, const char *suffix);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef OFFLINESTORE_H
+#define OFFLINESTORE_H
+
+#include "Arduino.h"
+#include "settings.h"                 // OFFLINE_RECORDS, OFFLINE_SPILL_RECORDS
+#include "growattRegisters.h"
+#ifdef OFFLINE_SPILL_RECORDS
+#include <LittleFS.h>
+#endif
+
+#ifndef OFFLINE_RECORDS
+#define OFFLINE_RECORDS 64            // snapshots kept in RAM
+#endif
+#define OFFLINE_DRAIN_BATCH 8         // snapshots published per drain() pass
+#define OFFLINE_DRAIN_INTERVAL 1000   // ms between two drain() passes
+
+// Input registers of one inverter as read while the broker could not be reached
+struct storedSnapshot
+{
+  uint32_t time;                              // s since boot when the registers were read
+  uint16_t words[INPUT_SNAPSHOT_WORDS];       // raw registers, see growattIF::InputSnapshot()
+  uint8_t inverter;
+};
+
+// Ring buffer of snapshots, the oldest first out. When it is full the oldest snapshot is overwritten,
+// or with OFFLINE_SPILL_RECORDS moved to a ring of the same records in a LittleFS file, which then
+// holds the older part and is drained first. The file is opened empty at boot, so spilled snapshots do
+// not survive a reboot.
+// drain() publishes with QoS 1: a published snapshot stays stored until acknowledge() reports its PUBACK,
+// and resend() publishes the unacknowledged ones again after a reconnect.
+class offlineStore {
+  private:
+    storedSnapshot records[OFFLINE_RECORDS];
+    uint16_t head = 0;
+    uint16_t count = 0;
+    uint32_t dropped = 0;           // snapshots lost since the last call of droppedSnapshots()
+    uint32_t lastDrain = 0;         // millis() of the last drain() pass
+    uint16_t sent = 0;              // oldest snapshots published and waiting for their PUBACK
+    uint8_t droppedSent = 0;        // published snapshots dropped before their PUBACK
+    void drop(uint16_t index);
+#ifdef OFFLINE_SPILL_RECORDS
+    File spill;
+    uint16_t spillHead = 0;
+    uint16_t spillCount = 0;
+    void spillRecord(const storedSnapshot &record);
+#endif
+
+  public:
+    void begin();
+    void push(const storedSnapshot &record);
+    bool oldest(storedSnapshot &record, uint16_t skip = 0);
+    void pop();
+    uint8_t drain(bool (*publish)(const storedSnapshot &record));
+    void acknowledge(uint8_t count);
+    void resend();
+    uint16_t size();
+    uint32_t droppedSnapshots();
+};
+
+#endif
@@ -1,19 +1,44 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
 #define DEBUG_SERIAL    
 #define DEBUG_MQTT       
 #define useModulPower   
+//#define SIMULATE_GROWATT           // answer Modbus requests from a simulated inverter, no RS485 hardware needed
+//#define PUBLISH_CHANGES            // publish only the input registers that left their deadband, plus a full snapshot every HEARTBEAT seconds
+//#define PUBLISH_MSGPACK            // also publish the input registers as MessagePack on <root>/data/msgpack
 //#define AHTXX_SENSOR               // add support for the AHT10, AHT15, AHT20 sensor family NOT SUPPORTED FOP ESP32 YET
 
+//#define MODBUS_HARDWARE_SERIAL     // RS485 on the hardware UART instead of SoftwareSerial, can also be set by the build environment
+//#define MODBUS_SHARED_BUS          // another master (the ShineWiFi datalogger) on the bus: send only into idle gaps and use the registers of its responses
+//#define MODBUS_LISTEN_ONLY         // never send on the bus, publish only the registers of the responses to the other master; no writes
+
 #define SERIAL_RATE     115200    // Serial speed for status info
+#if defined(MODBUS_HARDWARE_SERIAL) && defined(ESP8266)
+// UART0 is swapped to GPIO13/GPIO15 for the RS485 converter, the debug output moves to
+// Serial1 (TX only on GPIO2, D4), which is why the status LED is not available
+#define MAX485_DE       16        // D0, DE pin on the TTL to RS485 converter
+#define MAX485_RE_NEG   12        // D6, RE pin on the TTL to RS485 converter
+#define MAX485_RX       13        // D7, RO pin on the TTL to RS485 converter, fixed by the UART swap
+#define MAX485_TX       15        // D8, DI pin on the TTL to RS485 converter, fixed by the UART swap
+#define SerialDebug     Serial1
+#else
 #define MAX485_DE       16        // D0, DE pin on the TTL to RS485 converter
 #define MAX485_RE_NEG   13        // D7, RE pin on the TTL to RS485 converter
 #define MAX485_RX       14        // D5, RO pin on the TTL to RS485 converter
 #define MAX485_TX       12        // D6, DI pin on the TTL to RS485 converter
 #define STATUS_LED      2         // Status LED on the Wemos D1 mini (D4)
+#define SerialDebug     Serial
+#endif
 #define SCL_PIN         5
 #define SDA_PIN         4
 #define UPDATE_MODBUS   10         // 1: modbus device is read every second and data are anounced via mqtt
 #define UPDATE_STATUS   30        // 10: status mqtt message is sent every 10 seconds
 #define WIFICHECK       1           // 1: every second
+#define HEARTBEAT       300       // full data message at least every 300 seconds with PUBLISH_CHANGES
+#define OFFLINE_RECORDS 64        // input register snapshots kept in RAM (~90 bytes each) while the broker can not be reached, published on <root>/data/backlog after the reconnect
+//#define OFFLINE_SPILL_RECORDS 1024 // older snapshots beyond OFFLINE_RECORDS go to a LittleFS file of that many records
+#define SLAVE_IDS       { 1 }     // Modbus slave IDs of the inverters on the RS485 bus, e.g. { 1, 2, 3 }; with more than one each gets the topics below <root>/<slave ID>
 
 // Update the below parameters for your project
 // Also check NTP.h for some parameters as well
@@ -31,3 +56,5 @@ const char topicRootStart[] = "growatt-basement";      // MQTT root topic for th
 //IPAddress subnet(255, 255, 255, 0);
 //IPAddress primaryDNS(192, 168, 1, 254);   //optional
 //IPAddress secondaryDNS(8, 8, 4, 4); //optional
+
+#endif
@@ -49,8 +49,11 @@ Creates class object; initialize it using ModbusMaster::begin().
 ModbusMaster::ModbusMaster(void)
 {
   _idle = 0;
+  _u8MBStatus = ku8MBSuccess;
   _preTransmission = 0;
   _postTransmission = 0;
+  _u16ResponseTimeout = ku16MBResponseTimeout;
+  _u16InterCharTimeout = 0;
 }
 
 /**
@@ -78,6 +81,21 @@ void ModbusMaster::begin(uint8_t slave, Stream &serial)
 }
 
 
+/**
+Select the Modbus slave of the following transactions.
+
+Several slaves share one serial line this way. Call it only while no
+transaction is pending.
+
+@param slave Modbus slave ID (1..255)
+@ingroup setup
+*/
+void ModbusMaster::setSlave(uint8_t slave)
+{
+  _u8MBSlave = slave;
+}
+
+
 void ModbusMaster::beginTransmission(uint16_t u16Address)
 {
   _u16WriteAddress = u16Address;
@@ -222,6 +240,59 @@ void ModbusMaster::postTransmission(void (*postTransmission)())
 }
 
 
+/**
+Set response timeouts.
+
+The transaction fails with ModbusMaster::ku8MBResponseTimedOut if the
+first response byte does not arrive within u16ResponseTimeout, or if the
+line stays silent for more than u16InterCharTimeout once the response has
+started (truncated frame). With 0 as inter-character timeout only the
+response timeout applies, measured over the whole response.
+
+@param u16ResponseTimeout time to first response byte [milliseconds]
+@param u16InterCharTimeout maximum silence within a response [microseconds]
+@see ModbusMaster::frameSilence()
+@ingroup setup
+*/
+void ModbusMaster::setTimeouts(uint16_t u16ResponseTimeout, uint16_t u16InterCharTimeout)
+{
+  _u16ResponseTimeout = u16ResponseTimeout;
+  _u16InterCharTimeout = u16InterCharTimeout;
+}
+
+
+uint16_t ModbusMaster::getResponseTimeout()
+{
+  return _u16ResponseTimeout;
+}
+
+
+uint16_t ModbusMaster::getInterCharTimeout()
+{
+  return _u16InterCharTimeout;
+}
+
+
+/**
+Modbus RTU inter-frame silence t3.5.
+
+3.5 character times of 11 bits at the given baud rate; fixed at 1750 us
+above 19200 baud as required by the Modbus over serial line specification.
+
+@param u32BaudRate serial speed [baud]
+@return t3.5 [microseconds]
+@ingroup setup
+*/
+uint16_t ModbusMaster::frameSilence(uint32_t u32BaudRate)
+{
+  if (u32BaudRate > 19200)
+  {
+    return 1750;
+  }
+  return (uint16_t)((35UL * 11UL * 100000UL) / u32BaudRate);
+}
+
+
 /**
 Retrieve data from response buffer.
 
@@ -588,29 +659,296 @@ uint8_t ModbusMaster::readWriteMultipleRegisters(uint16_t u16ReadAddress,
 }
 
 
+/**
+Start Modbus function 0x03 Read Holding Registers without waiting for the
+response.
+
+The request is transmitted right away; the response is collected by
+ModbusMaster::pollTransaction(). Any blocking function must not be called
+before the transaction is finished.
+
+@param u16ReadAddress address of the first holding register (0x0000..0xFFFF)
+@param u16ReadQty quantity of holding registers to read (1..125, enforced by remote device)
+@ingroup register
+*/
+void ModbusMaster::startReadHoldingRegisters(uint16_t u16ReadAddress,
+  uint16_t u16ReadQty)
+{
+  _u16ReadAddress = u16ReadAddress;
+  _u16ReadQty = u16ReadQty;
+  startTransaction(ku8MBReadHoldingRegisters);
+}
+
+
+/**
+Start Modbus function 0x04 Read Input Registers without waiting for the
+response.
+
+@param u16ReadAddress address of the first input register (0x0000..0xFFFF)
+@param u16ReadQty quantity of input registers to read (1..125, enforced by remote device)
+@see ModbusMaster::startReadHoldingRegisters()
+@ingroup register
+*/
+void ModbusMaster::startReadInputRegisters(uint16_t u16ReadAddress,
+  uint16_t u16ReadQty)
+{
+  _u16ReadAddress = u16ReadAddress;
+  _u16ReadQty = u16ReadQty;
+  startTransaction(ku8MBReadInputRegisters);
+}
+
+
+/**
+Start Modbus function 0x06 Write Single Register without waiting for the
+response.
+
+@param u16WriteAddress address of the holding register (0x0000..0xFFFF)
+@param u16WriteValue value to be written to holding register (0x0000..0xFFFF)
+@see ModbusMaster::startReadHoldingRegisters()
+@ingroup register
+*/
+void ModbusMaster::startWriteSingleRegister(uint16_t u16WriteAddress,
+  uint16_t u16WriteValue)
+{
+  _u16WriteAddress = u16WriteAddress;
+  _u16WriteQty = 0;
+  _u16TransmitBuffer[0] = u16WriteValue;
+  startTransaction(ku8MBWriteSingleRegister);
+}
+
+
+/**
+Start Modbus function 0x10 Write Multiple Registers without waiting for the
+response. The values are taken from the transmit buffer, see
+ModbusMaster::setTransmitBuffer().
+
+@param u16WriteAddress address of the first holding register (0x0000..0xFFFF)
+@param u16WriteQty quantity of holding registers to write (1..123, enforced by remote device)
+@see ModbusMaster::startReadHoldingRegisters()
+@ingroup register
+*/
+void ModbusMaster::startWriteMultipleRegisters(uint16_t u16WriteAddress,
+  uint16_t u16WriteQty)
+{
+  _u16WriteAddress = u16WriteAddress;
+  _u16WriteQty = u16WriteQty;
+  startTransaction(ku8MBWriteMultipleRegisters);
+}
+
+
+/**
+Advance a transaction started by one of the start...() functions.
+
+Consumes the response bytes that are available and returns immediately;
+call it repeatedly, e.g. from loop().
+
+@return ModbusMaster::ku8MBPending while the transaction is running;
+0 on success; exception number on failure
+@ingroup register
+*/
+uint8_t ModbusMaster::pollTransaction()
+{
+  uint8_t i, u8Byte;
+  
+  // consume what has arrived until we run out of bytes, or an error occurs;
+  // CRC and response words are built while the bytes arrive
+  while (_u8MBStatus == ku8MBPending && _u8BytesLeft && _serial->available())
+  {
+#if __MODBUSMASTER_DEBUG__
+    digitalWrite(__MODBUSMASTER_DEBUG_PIN_A__, true);
+#endif
+    u8Byte = _serial->read();
+    if (_u8RxSize < sizeof(_u8RxHeader))
+    {
+      _u8RxHeader[_u8RxSize] = u8Byte;
+    }
+    _u16RxCRC = crc16_update(_u16RxCRC, u8Byte);
+    
+    // data bytes start behind slave ID, function code and byte count
+    if (_u8RxSize >= 3 && _u8RxSize < 3 + _u8RxHeader[2])
+    {
+      i = (_u8RxSize - 3) >> 1;
+      switch(_u8MBFunction)
+      {
+        case ku8MBReadCoils:
+        case ku8MBReadDiscreteInputs:
+          // response bytes are ordered L, H, L, H, ...; an odd last byte is zero-padded
+          if (i < ku8MaxBufferSize)
+          {
+            if ((_u8RxSize - 3) & 1)
+            {
+              _u16ResponseBuffer[i] = word(u8Byte, _u8RxPrevious);
+            }
+            else
+            {
+              _u16ResponseBuffer[i] = word(0, u8Byte);
+            }
+          }
+          _u8ResponseBufferLength = ((_u8RxSize - 3) & 1) ? i : i + 1;
+          break;
+          
+        case ku8MBReadInputRegisters:
+        case ku8MBReadHoldingRegisters:
+        case ku8MBReadWriteMultipleRegisters:
+          // response bytes are ordered H, L, H, L, ...
+          if ((_u8RxSize - 3) & 1)
+          {
+            if (i < ku8MaxBufferSize)
+            {
+              _u16ResponseBuffer[i] = word(_u8RxPrevious, u8Byte);
+            }
+            _u8ResponseBufferLength = i;
+          }
+          break;
+      }
+    }
+    _u8RxPrevious = u8Byte;
+    _u8RxSize++;
+    _u8BytesLeft--;
+    _u32LastByteTime = micros();
+#if __MODBUSMASTER_DEBUG__
+    digitalWrite(__MODBUSMASTER_DEBUG_PIN_A__, false);
+#endif
+    
+    // evaluate slave ID, function code once enough bytes have been read
+    if (_u8RxSize == 5)
+    {
+      // verify response is for correct Modbus slave
+      if (_u8RxHeader[0] != _u8MBSlave)
+      {
+        _u8MBStatus = ku8MBInvalidSlaveID;
+        break;
+      }
+      
+      // verify response is for correct Modbus function code (mask exception bit 7)
+      if ((_u8RxHeader[1] & 0x7F) != _u8MBFunction)
+      {
+        _u8MBStatus = ku8MBInvalidFunction;
+        break;
+      }
+      
+      // check whether Modbus exception occurred; return Modbus Exception Code
+      if (bitRead(_u8RxHeader[1], 7))
+      {
+        _u8MBStatus = _u8RxHeader[2];
+        break;
+      }
+      
+      // evaluate returned Modbus function code
+      switch(_u8RxHeader[1])
+      {
+        case ku8MBReadCoils:
+        case ku8MBReadDiscreteInputs:
+        case ku8MBReadInputRegisters:
+        case ku8MBReadHoldingRegisters:
+        case ku8MBReadWriteMultipleRegisters:
+          _u8BytesLeft = _u8RxHeader[2];
+          break;
+          
+        case ku8MBWriteSingleCoil:
+        case ku8MBWriteMultipleCoils:
+        case ku8MBWriteSingleRegister:
+        case ku8MBWriteMultipleRegisters:
+          _u8BytesLeft = 3;
+          break;
+          
+        case ku8MBMaskWriteRegister:
+          _u8BytesLeft = 5;
+          break;
+      }
+    }
+  }
+  
+  if (_u8MBStatus != ku8MBPending)
+  {
+    return _u8MBStatus;
+  }
+  
+  if (_u8BytesLeft)
+  {
+    if (_u8RxSize == 0 || !_u16InterCharTimeout)
+    {
+      if ((millis() - _u32StartTime) > _u16ResponseTimeout)
+      {
+        _u8MBStatus = ku8MBResponseTimedOut;
+      }
+    }
+    else if ((micros() - _u32LastByteTime) > _u16InterCharTimeout)
+    {
+      // line went quiet before the frame was complete
+      _u8MBStatus = ku8MBResponseTimedOut;
+    }
+    return _u8MBStatus;
+  }
+  
+  // verify CRC; running the CRC over the whole frame including its CRC yields 0
+  _u8MBStatus = (_u16RxCRC != 0) ? ku8MBInvalidCRC : ku8MBSuccess;
+  return _u8MBStatus;
+}
+
+
+/**
+Check whether a transaction is still running.
+
+@return true while ModbusMaster::pollTransaction() returns ku8MBPending
+@ingroup register
+*/
+bool ModbusMaster::transactionPending()
+{
+  return _u8MBStatus == ku8MBPending;
+}
+
+
 /* _____PRIVATE FUNCTIONS____________________________________________________ */
 /**
 Modbus transaction engine.
 Sequence:
-  - assemble Modbus Request Application Data Unit (ADU),
-    based on particular function called
-  - transmit request over selected serial port
-  - wait for/retrieve response
-  - evaluate/disassemble response
-  - return status (success/exception)
+  - ModbusMaster::startTransaction() assembles the Modbus Request
+    Application Data Unit (ADU), based on particular function called,
+    and transmits it over selected serial port
+  - ModbusMaster::pollTransaction() retrieves the response, disassembling
+    it into words and updating the CRC byte by byte as it arrives,
+    evaluates it and returns the status (success/exception)
+
+The response buffer is only valid when the transaction succeeded.
 
 @param u8MBFunction Modbus function (0x01..0xFF)
 @return 0 on success; exception number on failure
 */
 uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
+{
+  uint8_t u8MBStatus;
+  
+  startTransaction(u8MBFunction);
+  while ((u8MBStatus = pollTransaction()) == ku8MBPending)
+  {
+#if __MODBUSMASTER_DEBUG__
+    digitalWrite(__MODBUSMASTER_DEBUG_PIN_B__, true);
+#endif
+    if (_idle)
+    {
+      _idle();
+    }
+#if __MODBUSMASTER_DEBUG__
+    digitalWrite(__MODBUSMASTER_DEBUG_PIN_B__, false);
+#endif
+  }
+  return u8MBStatus;
+}
+
+
+/**
+Assemble and transmit the request, then prepare the receive state for
+ModbusMaster::pollTransaction().
+
+@param u8MBFunction Modbus function (0x01..0xFF)
+*/
+void ModbusMaster::startTransaction(uint8_t u8MBFunction)
 {
   uint8_t u8ModbusADU[256];
   uint8_t u8ModbusADUSize = 0;
   uint8_t i, u8Qty;
   uint16_t u16CRC;
-  uint32_t u32StartTime;
-  uint8_t u8BytesLeft = 8;
-  uint8_t u8MBStatus = ku8MBSuccess;
   
   // assemble Modbus Request Application Data Unit
   u8ModbusADU[u8ModbusADUSize++] = _u8MBSlave;
@@ -697,11 +1035,7 @@ uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
   }
   
   // append CRC
-  u16CRC = 0xFFFF;
-  for (i = 0; i < u8ModbusADUSize; i++)
-  {
-      u16CRC = crc16_update(u16CRC, u8ModbusADU[i]);
-  }
+  u16CRC = crc16_update_block(0xFFFF, u8ModbusADU, u8ModbusADUSize);
   u8ModbusADU[u8ModbusADUSize++] = lowByte(u16CRC);
   u8ModbusADU[u8ModbusADUSize++] = highByte(u16CRC);
   u8ModbusADU[u8ModbusADUSize] = 0;
@@ -719,163 +1053,19 @@ uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
     _serial->write(u8ModbusADU[i]);
   }
   
-  u8ModbusADUSize = 0;
   _serial->flush();    // flush transmit buffer
   if (_postTransmission)
   {
     _postTransmission();
   }
   
-  // loop until we run out of time or bytes, or an error occurs
-  u32StartTime = millis();
-  while (u8BytesLeft && !u8MBStatus)
-  {
-    if (_serial->available())
-    {
-#if __MODBUSMASTER_DEBUG__
-      digitalWrite(__MODBUSMASTER_DEBUG_PIN_A__, true);
-#endif
-      u8ModbusADU[u8ModbusADUSize++] = _serial->read();
-      u8BytesLeft--;
-#if __MODBUSMASTER_DEBUG__
-      digitalWrite(__MODBUSMASTER_DEBUG_PIN_A__, false);
-#endif
-    }
-    else
-    {
-#if __MODBUSMASTER_DEBUG__
-      digitalWrite(__MODBUSMASTER_DEBUG_PIN_B__, true);
-#endif
-      if (_idle)
-      {
-        _idle();
-      }
-#if __MODBUSMASTER_DEBUG__
-      digitalWrite(__MODBUSMASTER_DEBUG_PIN_B__, false);
-#endif
-    }
-    
-    // evaluate slave ID, function code once enough bytes have been read
-    if (u8ModbusADUSize == 5)
-    {
-      // verify response is for correct Modbus slave
-      if (u8ModbusADU[0] != _u8MBSlave)
-      {
-        u8MBStatus = ku8MBInvalidSlaveID;
-        break;
-      }
-      
-      // verify response is for correct Modbus function code (mask exception bit 7)
-      if ((u8ModbusADU[1] & 0x7F) != u8MBFunction)
-      {
-        u8MBStatus = ku8MBInvalidFunction;
-        break;
-      }
-      
-      // check whether Modbus exception occurred; return Modbus Exception Code
-      if (bitRead(u8ModbusADU[1], 7))
-      {
-        u8MBStatus = u8ModbusADU[2];
-        break;
-      }
-      
-      // evaluate returned Modbus function code
-      switch(u8ModbusADU[1])
-      {
-        case ku8MBReadCoils:
-        case ku8MBReadDiscreteInputs:
-        case ku8MBReadInputRegisters:
-        case ku8MBReadHoldingRegisters:
-        case ku8MBReadWriteMultipleRegisters:
-          u8BytesLeft = u8ModbusADU[2];
-          break;
-          
-        case ku8MBWriteSingleCoil:
-        case ku8MBWriteMultipleCoils:
-        case ku8MBWriteSingleRegister:
-        case ku8MBWriteMultipleRegisters:
-          u8BytesLeft = 3;
-          break;
-          
-        case ku8MBMaskWriteRegister:
-          u8BytesLeft = 5;
-          break;
-      }
-    }
-    if ((millis() - u32StartTime) > ku16MBResponseTimeout)
-    {
-      u8MBStatus = ku8MBResponseTimedOut;
-    }
-  }
-  
-  // verify response is large enough to inspect further
-  if (!u8MBStatus && u8ModbusADUSize >= 5)
-  {
-    // calculate CRC
-    u16CRC = 0xFFFF;
-    for (i = 0; i < (u8ModbusADUSize - 2); i++)
-    {
-      u16CRC = crc16_update(u16CRC, u8ModbusADU[i]);
-    }
-    
-    // verify CRC
-    if (!u8MBStatus && (lowByte(u16CRC) != u8ModbusADU[u8ModbusADUSize - 2] ||
-      highByte(u16CRC) != u8ModbusADU[u8ModbusADUSize - 1]))
-    {
-      u8MBStatus = ku8MBInvalidCRC;
-    }
-  }
-
-  // disassemble ADU into words
-  if (!u8MBStatus)
-  {
-    // evaluate returned Modbus function code
-    switch(u8ModbusADU[1])
-    {
-      case ku8MBReadCoils:
-      case ku8MBReadDiscreteInputs:
-        // load bytes into word; response bytes are ordered L, H, L, H, ...
-        for (i = 0; i < (u8ModbusADU[2] >> 1); i++)
-        {
-          if (i < ku8MaxBufferSize)
-          {
-            _u16ResponseBuffer[i] = word(u8ModbusADU[2 * i + 4], u8ModbusADU[2 * i + 3]);
-          }
-          
-          _u8ResponseBufferLength = i;
-        }
-        
-        // in the event of an odd number of bytes, load last byte into zero-padded word
-        if (u8ModbusADU[2] % 2)
-        {
-          if (i < ku8MaxBufferSize)
-          {
-            _u16ResponseBuffer[i] = word(0, u8ModbusADU[2 * i + 3]);
-          }
-          
-          _u8ResponseBufferLength = i + 1;
-        }
-        break;
-        
-      case ku8MBReadInputRegisters:
-      case ku8MBReadHoldingRegisters:
-      case ku8MBReadWriteMultipleRegisters:
-        // load bytes into word; response bytes are ordered H, L, H, L, ...
-        for (i = 0; i < (u8ModbusADU[2] >> 1); i++)
-        {
-          if (i < ku8MaxBufferSize)
-          {
-            _u16ResponseBuffer[i] = word(u8ModbusADU[2 * i + 3], u8ModbusADU[2 * i + 4]);
-          }
-          
-          _u8ResponseBufferLength = i;
-        }
-        break;
-    }
-  }
-  
+  _u8MBFunction = u8MBFunction;
+  _u8MBStatus = ku8MBPending;
+  _u8RxSize = 0;
+  _u8BytesLeft = 8;
+  _u16RxCRC = 0xFFFF;
+  _u32StartTime = millis();
   _u8TransmitBufferIndex = 0;
   u16TransmitBufferLength = 0;
   _u8ResponseBufferIndex = 0;
-  return u8MBStatus;
 }
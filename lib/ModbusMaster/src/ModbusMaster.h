@@ -67,9 +67,14 @@ Set to 1 to enable debugging features within class:
     ModbusMaster();
    
     void begin(uint8_t, Stream &serial);
+    void setSlave(uint8_t);
     void idle(void (*)());
     void preTransmission(void (*)());
     void postTransmission(void (*)());
+    void setTimeouts(uint16_t, uint16_t);
+    uint16_t getResponseTimeout();
+    uint16_t getInterCharTimeout();
+    static uint16_t frameSilence(uint32_t);
 
     // Modbus exception codes
     /**
@@ -167,8 +172,9 @@ Set to 1 to enable debugging features within class:
     /**
     ModbusMaster response timed out exception.
     
-    The entire response was not received within the timeout period, 
-    ModbusMaster::ku8MBResponseTimeout. 
+    The response did not start within the response timeout, or the line
+    went silent for longer than the inter-character timeout before the
+    response was complete (see ModbusMaster::setTimeouts()).
     
     @ingroup constant
     */
@@ -183,6 +189,17 @@ Set to 1 to enable debugging features within class:
     */
     static const uint8_t ku8MBInvalidCRC                 = 0xE3;
     
+    /**
+    ModbusMaster transaction pending.
+    
+    Returned by ModbusMaster::pollTransaction() while the response of a
+    transaction started with one of the start...() functions is still
+    being received.
+    
+    @ingroup constant
+    */
+    static const uint8_t ku8MBPending                    = 0xFF;
+    
     uint16_t getResponseBuffer(uint8_t);
     void     clearResponseBuffer();
     uint8_t  setTransmitBuffer(uint8_t, uint16_t);
@@ -212,6 +229,13 @@ Set to 1 to enable debugging features within class:
     uint8_t  readWriteMultipleRegisters(uint16_t, uint16_t, uint16_t, uint16_t);
     uint8_t  readWriteMultipleRegisters(uint16_t, uint16_t);
     
+    void     startReadHoldingRegisters(uint16_t, uint16_t);
+    void     startReadInputRegisters(uint16_t, uint16_t);
+    void     startWriteSingleRegister(uint16_t, uint16_t);
+    void     startWriteMultipleRegisters(uint16_t, uint16_t);
+    uint8_t  pollTransaction();
+    bool     transactionPending();
+    
   private:
     Stream* _serial;                                             ///< reference to serial port object
     uint8_t  _u8MBSlave;                                         ///< Modbus slave (1..255) initialized in begin()
@@ -244,10 +268,24 @@ Set to 1 to enable debugging features within class:
     static const uint8_t ku8MBReadWriteMultipleRegisters = 0x17; ///< Modbus function 0x17 Read Write Multiple Registers
     
     // Modbus timeout [milliseconds]
-    static const uint16_t ku16MBResponseTimeout          = 2000; ///< Modbus timeout [milliseconds]
+    static const uint16_t ku16MBResponseTimeout          = 2000; ///< default Modbus timeout [milliseconds]
+    uint16_t _u16ResponseTimeout;                                ///< time to first response byte [milliseconds]
+    uint16_t _u16InterCharTimeout;                               ///< maximum silence within a response [microseconds], 0: off
+    
+    // state of the running transaction, see pollTransaction()
+    uint8_t _u8MBFunction;                                       ///< function code of the request
+    uint8_t _u8MBStatus;                                         ///< ku8MBPending while the response is received
+    uint8_t _u8RxHeader[5];                                      ///< first bytes of the response
+    uint8_t _u8RxPrevious;                                       ///< last response byte, high byte of the next word
+    uint8_t _u8RxSize;                                           ///< response bytes received
+    uint8_t _u8BytesLeft;                                        ///< response bytes still expected
+    uint16_t _u16RxCRC;                                          ///< running CRC of the response
+    uint32_t _u32StartTime;                                      ///< millis() when the request was sent
+    uint32_t _u32LastByteTime;                                   ///< micros() of the last response byte
     
     // master function that conducts Modbus transactions
     uint8_t ModbusMasterTransaction(uint8_t u8MBFunction);
+    void startTransaction(uint8_t u8MBFunction);
     
     // idle callback function; gets called during idle time between TX and RX
     void (*_idle)();
@@ -0,0 +1,556 @@
+#include "asyncMqtt.h"
+
+// MQTT 3.1.1 packet types, in the high nibble of the fixed header
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_SUBSCRIBE   0x82       // with the reserved flags of SUBSCRIBE
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+#define MQTT_QOS1        0x02
+#define MQTT_RETAIN      0x01
+
+asyncMqtt::asyncMqtt(const char *domain, uint16_t port) {
+  this->domain = domain;
+  this->port = port;
+  _state = stateDisconnected;
+  inHead = 0;
+  inTail = 0;
+  for (uint8_t i = 0; i < MQTT_INFLIGHT; i++)
+  {
+    inflight[i].packetId = 0;
+    inflight[i].acked = false;
+  }
+
+  // TCP task: the handlers only parse and set the state, sending is left to loop()
+  client.onData([](void *arg, AsyncClient *client, void *data, size_t length) {
+    ((asyncMqtt *)arg)->receive((const uint8_t *)data, length);
+  }, this);
+  client.onDisconnect([](void *arg, AsyncClient *client) {
+    asyncMqtt *mqtt = (asyncMqtt *)arg;
+    int connecting = stateConnecting, connected = stateConnected;
+    if (!mqtt->_state.compare_exchange_strong(connecting, stateConnectFailed))
+      mqtt->_state.compare_exchange_strong(connected, stateConnectionLost);
+  }, this);
+  client.onError([](void *arg, AsyncClient *client, int8_t error) {
+    int connecting = stateConnecting;
+    ((asyncMqtt *)arg)->_state.compare_exchange_strong(connecting, stateConnectFailed);
+  }, this);
+}
+
+void asyncMqtt::setServer(const char *domain, uint16_t port) {
+  this->domain = domain;
+  this->port = port;
+}
+
+void asyncMqtt::setCallback(void (*callback)(char *topic, uint8_t *payload, unsigned int length)) {
+  this->callback = callback;
+}
+
+// The incoming messages are queued until loop(), twice the largest packet
+bool asyncMqtt::setBufferSize(uint16_t size) {
+  if (_state == stateConnecting || _state == stateConnected || size == 0 || size > UINT16_MAX / 2)
+  {
+    return false;
+  }
+  free(rxBuffer);
+  free(inBuffer);
+  free(message);
+  rxBuffer = (uint8_t *)malloc(size);
+  inBuffer = (uint8_t *)malloc(2 * size);
+  message = (uint8_t *)malloc(size + 1);
+  rxSize = size;
+  inSize = 2 * size;
+  return rxBuffer && inBuffer && message;
+}
+
+bool asyncMqtt::setOutputBufferSize(uint16_t size) {
+  if (_state == stateConnecting || _state == stateConnected || size == 0)
+  {
+    return false;
+  }
+  free(outBuffer);
+  outBuffer = (uint8_t *)malloc(size);
+  outSize = size;
+  return outBuffer != NULL;
+}
+
+// Encodes the remaining length of a packet, returns the bytes used
+uint8_t asyncMqtt::lengthField(uint32_t length, uint8_t *field) {
+  uint8_t bytes = 0;
+
+  do
+  {
+    field[bytes] = length & 0x7F;
+    length >>= 7;
+    if (length)
+      field[bytes] |= 0x80;
+    bytes++;
+  } while (length && bytes < 4);
+  return bytes;
+}
+
+// Queues the fixed header of a packet with length bytes following, when the whole packet fits into the queue.
+// The queue is handed to TCP first when needed.
+bool asyncMqtt::beginPacket(uint8_t header, uint32_t length) {
+  uint8_t field[4];
+  uint8_t fieldLength = lengthField(length, field);
+  uint32_t total = 1 + fieldLength + length;
+
+  if (publishLeft || length > 0x0FFFFFFF)
+  {
+    return false;
+  }
+  if (total > queueFree())
+  {
+    flush();
+  }
+  if (total > queueFree())
+  {
+    return false;
+  }
+  queue(&header, 1);
+  queue(field, fieldLength);
+  return true;
+}
+
+// Space was reserved by beginPacket()
+void asyncMqtt::queue(const uint8_t *data, uint16_t length) {
+  uint16_t tail = (outHead + outLength) % outSize;
+  uint16_t chunk = min((uint16_t)(outSize - tail), length);
+
+  memcpy(outBuffer + tail, data, chunk);
+  memcpy(outBuffer, data + chunk, length - chunk);
+  outLength += length;
+}
+
+void asyncMqtt::queueWord(uint16_t word) {
+  uint8_t bytes[2] = { (uint8_t)(word >> 8), (uint8_t)(word & 0xFF) };
+
+  queue(bytes, 2);
+}
+
+void asyncMqtt::queueString(const char *text) {
+  uint16_t length = strlen(text);
+
+  queueWord(length);
+  queue((const uint8_t *)text, length);
+}
+
+// Next packet ID, not 0 and not one of a QoS 1 message still in flight
+uint16_t asyncMqtt::packetId() {
+  bool used;
+
+  do
+  {
+    if (++nextPacketId == 0)
+      nextPacketId = 1;
+    used = false;
+    for (uint8_t i = 0; i < MQTT_INFLIGHT; i++)
+    {
+      used |= inflight[i].packetId == nextPacketId;
+    }
+  } while (used);
+  return nextPacketId;
+}
+
+// Starts the DNS lookup and the TCP handshake, CONNECT waits in the queue until TCP is up.
+// true when the attempt was started, connected() tells when the broker accepted it.
+bool asyncMqtt::connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos,
+                        bool willRetain, const char *willMessage) {
+  uint32_t length = 10 + 2 + strlen(id);
+  uint8_t flags = 0x02;                                 // clean session
+
+  if (_state == stateConnecting || !outBuffer || !rxBuffer)
+  {
+    return false;
+  }
+  client.close(true);
+  outHead = 0;
+  outLength = 0;
+  publishLeft = 0;
+  rxStep = rxFixedHeader;
+  inHead = 0;
+  inTail = 0;
+  pingOutstanding = false;
+  // a clean session: the PUBACKs of the last connection do not come any more
+  for (uint8_t i = 0; i < MQTT_INFLIGHT; i++)
+  {
+    inflight[i].packetId = 0;
+    inflight[i].acked = false;
+  }
+  inflightHead = 0;
+  inflightCount = 0;
+
+  if (willTopic)
+  {
+    length += 2 + strlen(willTopic) + 2 + strlen(willMessage);
+    flags |= 0x04 | (willQos & 0x03) << 3 | (willRetain ? 0x20 : 0);
+  }
+  if (user)
+  {
+    length += 2 + strlen(user);
+    flags |= 0x80;
+  }
+  if (pass)
+  {
+    length += 2 + strlen(pass);
+    flags |= 0x40;
+  }
+  if (!beginPacket(MQTT_CONNECT, length))
+  {
+    return false;
+  }
+  queueString("MQTT");
+  const uint8_t level[] = { 4, flags };                 // protocol level 3.1.1
+  queue(level, 2);
+  queueWord(MQTT_KEEPALIVE_TIME);
+  queueString(id);
+  if (willTopic)
+  {
+    queueString(willTopic);
+    queueString(willMessage);
+  }
+  if (user)
+    queueString(user);
+  if (pass)
+    queueString(pass);
+
+  connectStart = millis();
+  lastIn = millis();
+  lastOut = millis();
+  _state = stateConnecting;
+  if (!client.connect(domain, port))
+  {
+    _state = stateConnectFailed;
+    return false;
+  }
+  return true;
+}
+
+void asyncMqtt::disconnect() {
+  if (_state == stateConnected && beginPacket(MQTT_DISCONNECT, 0))
+  {
+    flush();
+  }
+  client.close();
+  _state = stateDisconnected;
+}
+
+bool asyncMqtt::connected() {
+  return _state == stateConnected;
+}
+
+int asyncMqtt::state() {
+  return _state;
+}
+
+uint8_t asyncMqtt::inflightMessages() {
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < inflightCount; i++)
+  {
+    count += !inflight[(inflightHead + i) % MQTT_INFLIGHT].acked;
+  }
+  return count;
+}
+
+// The QoS 1 messages acknowledged since the last call, counted from the oldest in flight. A PUBACK that comes
+// before the one of an older message waits for it, so the sketch can drop its copies in the order it published.
+uint8_t asyncMqtt::acknowledged() {
+  uint8_t count = 0;
+
+  while (inflightCount && inflight[inflightHead].acked)
+  {
+    inflight[inflightHead].packetId = 0;
+    inflight[inflightHead].acked = false;
+    inflightHead = (inflightHead + 1) % MQTT_INFLIGHT;
+    inflightCount--;
+    count++;
+  }
+  return count;
+}
+
+bool asyncMqtt::publish(const char *topic, const char *payload, bool retained) {
+  size_t length = strlen(payload);
+
+  return beginPublish(topic, length, retained) && write((const uint8_t *)payload, length) == length && endPublish();
+}
+
+// Starts a message of length payload bytes, which follow with write(). The whole packet is reserved in the queue,
+// so a message is either sent complete or refused here. QoS 1 needs a free in-flight slot as well.
+bool asyncMqtt::beginPublish(const char *topic, unsigned int length, bool retained, uint8_t qos) {
+  uint16_t topicLength = strlen(topic);
+  uint32_t remaining = 2 + topicLength + (qos ? 2 : 0) + length;
+
+  if (!connected() || (qos && inflightCount == MQTT_INFLIGHT))
+  {
+    return false;
+  }
+  if (!beginPacket(MQTT_PUBLISH | (qos ? MQTT_QOS1 : 0) | (retained ? MQTT_RETAIN : 0), remaining))
+  {
+    return false;
+  }
+  queueString(topic);
+  if (qos)
+  {
+    inflightMessage &slot = inflight[(inflightHead + inflightCount) % MQTT_INFLIGHT];
+    slot.acked = false;
+    slot.packetId = packetId();
+    inflightCount++;
+    queueWord(slot.packetId);
+  }
+  publishLeft = length;
+  return true;
+}
+
+size_t asyncMqtt::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t asyncMqtt::write(const uint8_t *buffer, size_t size) {
+  if (size > publishLeft)
+  {
+    size = publishLeft;
+  }
+  queue(buffer, size);
+  publishLeft -= size;
+  return size;
+}
+
+// Ends the message of beginPublish(). Payload bytes that were not written are sent as blanks to keep
+// the stream in step, the message then counts as failed.
+int asyncMqtt::endPublish() {
+  bool complete = publishLeft == 0;
+  const uint8_t blank = ' ';
+
+  while (publishLeft)
+  {
+    write(&blank, 1);
+  }
+  return complete;
+}
+
+bool asyncMqtt::subscribe(const char *topic) {
+  const uint8_t qos = 0;
+
+  if (!connected() || !beginPacket(MQTT_SUBSCRIBE, 2 + 2 + strlen(topic) + 1))
+  {
+    return false;
+  }
+  queueWord(packetId());
+  queueString(topic);
+  queue(&qos, 1);
+  return true;
+}
+
+// Hands the queue to TCP as far as its send buffer takes it, in sends of at most one segment, so that
+// sentSegments counts the TCP segments
+void asyncMqtt::flush() {
+  if (!client.connected())
+  {
+    return;                                             // CONNECT waits for the TCP handshake
+  }
+  while (outLength)
+  {
+    size_t chunk = min((size_t)min(outLength, (uint16_t)(outSize - outHead)), client.space());
+    chunk = min(chunk, (size_t)MQTT_SEGMENT_SIZE);
+    if (chunk == 0 || client.add((const char *)outBuffer + outHead, chunk, ASYNC_WRITE_FLAG_COPY) != chunk)
+      break;
+    outHead = (outHead + chunk) % outSize;
+    outLength -= chunk;
+    if (!client.send())
+      break;
+    sentBytes += chunk;
+    sentSegments++;
+    lastOut = millis();
+  }
+  if (pingOutstanding && !pingSent && (int32_t)(sentBytes - pingEnd) >= 0)
+  {
+    pingSent = true;
+    pingSentAt = millis();
+  }
+}
+
+// TCP task: reassembles the packets from the received segments
+void asyncMqtt::receive(const uint8_t *data, size_t length) {
+  size_t chunk;
+
+  lastIn = millis();
+  while (length)
+  {
+    switch (rxStep)
+    {
+      case rxFixedHeader:
+        rxHeader = *data++;
+        length--;
+        rxLength = 0;
+        rxShift = 0;
+        rxStep = rxRemainingLength;
+        break;
+
+      case rxRemainingLength:
+        if (rxShift == 21 && (*data & 0x80))
+        {
+          // a fifth length byte: the stream is out of step, loop() drops the connection
+          int connected = stateConnected, connecting = stateConnecting;
+          if (!_state.compare_exchange_strong(connected, stateConnectionLost))
+            _state.compare_exchange_strong(connecting, stateConnectFailed);
+          rxStep = rxBroken;
+          return;
+        }
+        rxLength |= (uint32_t)(*data & 0x7F) << rxShift;
+        rxShift += 7;
+        length--;
+        if (*data++ & 0x80)
+          break;
+        rxIndex = 0;
+        rxStep = rxBody;
+        if (rxLength == 0)
+        {
+          handlePacket();
+          rxStep = rxFixedHeader;
+        }
+        break;
+
+      case rxBody:
+        chunk = min(length, (size_t)(rxLength - rxIndex));
+        if (rxIndex < rxSize)
+          memcpy(rxBuffer + rxIndex, data, min(chunk, (size_t)(rxSize - rxIndex)));
+        rxIndex += chunk;
+        data += chunk;
+        length -= chunk;
+        if (rxIndex == rxLength)
+        {
+          if (rxLength <= rxSize)
+            handlePacket();
+          rxStep = rxFixedHeader;
+        }
+        break;
+
+      case rxBroken:
+        return;                                         // until connect()
+    }
+  }
+}
+
+// TCP task: a complete packet is in rxBuffer
+void asyncMqtt::handlePacket() {
+  uint16_t topicLength, payloadLength, payloadStart, head;
+  uint8_t lengths[4];
+
+  switch (rxHeader & 0xF0)
+  {
+    case MQTT_CONNACK:
+      if (rxLength == 2 && _state == stateConnecting)
+        _state = rxBuffer[1] == 0 ? stateConnected : rxBuffer[1];
+      break;
+
+    case MQTT_PUBLISH:
+      // the subscriptions are QoS 0, a message is never acknowledged
+      if (rxLength < 2)
+        break;
+      topicLength = (rxBuffer[0] << 8) | rxBuffer[1];
+      payloadStart = 2 + topicLength + ((rxHeader & 0x06) ? 2 : 0);
+      if (payloadStart > rxLength)
+        break;
+      payloadLength = rxLength - payloadStart;
+      if (4 + topicLength + payloadLength > inFree())
+        break;                                          // loop() is behind, the message is dropped
+      head = inHead;
+      lengths[0] = topicLength >> 8;
+      lengths[1] = topicLength;
+      lengths[2] = payloadLength >> 8;
+      lengths[3] = payloadLength;
+      for (uint8_t i = 0; i < 4; i++)
+        inBuffer[head++ % inSize] = lengths[i];
+      for (uint16_t i = 0; i < topicLength; i++)
+        inBuffer[head++ % inSize] = rxBuffer[2 + i];
+      for (uint16_t i = 0; i < payloadLength; i++)
+        inBuffer[head++ % inSize] = rxBuffer[payloadStart + i];
+      inHead = head % inSize;
+      break;
+
+    case MQTT_PUBACK:
+      if (rxLength < 2)
+        break;
+      for (uint8_t i = 0; i < MQTT_INFLIGHT; i++)
+      {
+        if (inflight[i].packetId == ((rxBuffer[0] << 8) | rxBuffer[1]))
+          inflight[i].acked = true;
+      }
+      break;
+
+    case MQTT_PINGRESP:
+      pingOutstanding = false;
+      break;
+  }
+}
+
+// Runs the connection from the loop of the sketch: times out the connect, delivers the received messages to the
+// callback and keeps the connection alive. false when not connected.
+bool asyncMqtt::loop() {
+  int state = _state;
+  uint16_t tail, topicLength, payloadLength;
+
+  if (state == stateConnecting)
+  {
+    if (millis() - connectStart > MQTT_CONNECT_TIMEOUT)
+    {
+      client.close(true);
+      _state = stateConnectionTimeout;
+    }
+    else
+    {
+      flush();                                          // CONNECT, once TCP is up
+    }
+    return false;
+  }
+  if (state != stateConnected)
+  {
+    if (client.connected())
+      client.close(true);                               // refused by the broker, or a broken packet
+    return false;
+  }
+
+  while (inTail != inHead)
+  {
+    tail = inTail;
+    topicLength = (inByte(tail) << 8) | inByte(tail + 1);
+    payloadLength = (inByte(tail + 2) << 8) | inByte(tail + 3);
+    tail += 4;
+    for (uint16_t i = 0; i < topicLength; i++)
+      message[i] = inByte(tail++);
+    message[topicLength] = '\0';
+    for (uint16_t i = 0; i < payloadLength; i++)
+      message[topicLength + 1 + i] = inByte(tail++);
+    inTail = tail % inSize;
+    if (callback)
+      callback((char *)message, message + topicLength + 1, payloadLength);
+  }
+
+  // keep alive: a ping after MQTT_KEEPALIVE_TIME of silence, the connection is lost when it is not answered within
+  // MQTT_KEEPALIVE_TIME of handing it to TCP. A ping that waits for room in the send buffer does not time out.
+  if (pingOutstanding)
+  {
+    if (pingSent && millis() - pingSentAt > MQTT_KEEPALIVE_TIME * 1000UL)
+    {
+      client.close(true);
+      _state = stateConnectionTimeout;
+      return false;
+    }
+  }
+  else if (millis() - lastIn > MQTT_KEEPALIVE_TIME * 1000UL || millis() - lastOut > MQTT_KEEPALIVE_TIME * 1000UL)
+  {
+    if (beginPacket(MQTT_PINGREQ, 0))
+    {
+      pingOutstanding = true;
+      pingSent = false;
+      pingEnd = sentBytes + outLength;
+      flush();
+    }
+  }
+  return true;
+}
@@ -6,6 +6,16 @@ growattIF::growattIF(int _PinMAX485_RE_NEG, int _PinMAX485_DE, int _PinMAX485_RX
   PinMAX485_RX = _PinMAX485_RX;
   PinMAX485_TX = _PinMAX485_TX;
 
+  // every group is due on the first read
+  memset(inverters, 0, sizeof(inverters));
+  for (uint8_t i = 0; i < INVERTERS; i++)
+  {
+    for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+    {
+      inverters[i].groupAge[g] = registerGroups[g].divider;
+    }
+  }
+
   // Init outputs, RS485 in receive mode
   pinMode(PinMAX485_RE_NEG, OUTPUT);
   pinMode(PinMAX485_DE, OUTPUT);
@@ -16,7 +26,36 @@ growattIF::growattIF(int _PinMAX485_RE_NEG, int _PinMAX485_DE, int _PinMAX485_RX
 void growattIF::initGrowatt() {
   serial = new SoftwareSerial (PinMAX485_RX, PinMAX485_TX, false); //RX, TX
   serial->begin(MODBUS_RATE);
-  growattInterface.begin(SLAVE_ID , *serial);
+  initGrowatt(*serial);
+}
+
+// RS485 on the hardware UART: UART0 swapped to GPIO13 (RX) / GPIO15 (TX) on ESP8266,
+// any UART with the RX/TX pins of the constructor on ESP32
+void growattIF::initGrowatt(HardwareSerial &port) {
+#ifdef ESP32
+  port.begin(MODBUS_RATE, SERIAL_8N1, PinMAX485_RX, PinMAX485_TX);
+#else
+  port.begin(MODBUS_RATE);
+  port.swap();
+#endif
+  initGrowatt((Stream &)port);
+}
+
+// Use any Stream as Modbus line, e.g. the growattSimulator
+void growattIF::initGrowatt(Stream &port) {
+  growattInterface.begin(slaveIds[0], port);
+#ifdef MODBUS_SHARED_BUS
+  this->port = &port;
+  sniffer.begin(ModbusMaster::frameSilence(MODBUS_RATE), FOREIGN_RESPONSE_TIMEOUT);
+  busStatisticsStart = millis();
+#endif
+  holdingPlanSize = planRequests(holdingRegisterMap, HOLDING_REGISTER_COUNT, 1 << grpSettings, holdingPlan);
+  for (uint8_t i = 0; i < INVERTERS; i++)
+  {
+    inverters[i].statisticsStart = millis();
+  }
+  // fail fast on a silent inverter, detect truncated frames by the t3.5 inter-frame silence
+  growattInterface.setTimeouts(MODBUS_RESPONSE_TIMEOUT, ModbusMaster::frameSilence(MODBUS_RATE));
 
   static growattIF* obj = this;                               //pointer to the object
   // Callbacks allow us to configure the RS485 transceiver correctly
@@ -29,13 +68,17 @@ void growattIF::initGrowatt() {
   });
 }
 
-uint8_t growattIF::writeRegister(uint16_t reg, uint16_t message) {
-  return growattInterface.writeSingleRegister(reg, message);
+// responseTimeout in ms until the first byte, interCharTimeout in us of silence within a response
+void growattIF::setTimeouts(uint16_t responseTimeout, uint16_t interCharTimeout) {
+  growattInterface.setTimeouts(responseTimeout, interCharTimeout);
 }
 
-uint16_t growattIF::readRegister(uint16_t reg) {
-  growattInterface.readHoldingRegisters(reg, 1);
-  return growattInterface.getResponseBuffer(0);				// returns 16bit
+uint16_t growattIF::getResponseTimeout() {
+  return growattInterface.getResponseTimeout();
+}
+
+uint16_t growattIF::getInterCharTimeout() {
+  return growattInterface.getInterCharTimeout();
 }
 
 void growattIF::preTransmission() {
@@ -48,386 +91,829 @@ void growattIF::postTransmission() {
   digitalWrite(PinMAX485_DE, 0);
 }
 
-uint8_t growattIF::ReadInputRegisters() {
-  uint8_t result;
+// Walks the register map over the raw register image, 32 bit values are high word first
+void growattIF::decodeRegisters(const registerDescriptor *map, uint8_t count, const uint16_t *image, int32_t *values) {
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const registerDescriptor &reg = map[i];
+    uint32_t raw = image[reg.address];
+    if (reg.width == 2)
+      raw = (raw << 16) | image[reg.address + 1];
+    else if (reg.isSigned)
+      raw = (int16_t)raw;
+    values[i] = (int32_t)raw;
+  }
+}
 
-   #ifndef ARDUINO_ESP32_DEV
-  ESP.wdtDisable();
-  result = growattInterface.readInputRegisters(0 * 64, 64);
-  ESP.wdtEnable(1);
-  #else
-  result = growattInterface.readInputRegisters(0 * 64, 64);
-  #endif
+// Computes the read requests for the registers of the given groups (bit mask). Neighbouring registers are read in
+// one request; a gap is read along when its wire time is less than the cost of one more request
+// round-trip. The plan with the least bus time is found by dynamic programming over the used ranges.
+uint8_t growattIF::planRequests(const registerDescriptor *map, uint8_t count, uint8_t groups, registerRequest *plan)
+{
+  // request and response frame overhead plus the bus idle time between requests, in bytes on the wire
+  const uint32_t requestCost = 8 + 5 + (MODBUS_REQUEST_GAP * (MODBUS_RATE / 11UL)) / 1000 + 4;
+  bool used[REGISTER_IMAGE_SIZE] = {};
+  uint8_t rangeStart[REGISTER_IMAGE_SIZE / 2 + 1], rangeEnd[REGISTER_IMAGE_SIZE / 2 + 1];
+  uint8_t ranges = 0;
+  uint32_t cost[REGISTER_IMAGE_SIZE / 2 + 2];
+  uint8_t first[REGISTER_IMAGE_SIZE / 2 + 2];
+  uint8_t size = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!(groups & (1 << map[i].group)))
+      continue;
+    for (uint8_t w = 0; w < map[i].width; w++)
+    {
+      used[map[i].address + w] = true;
+    }
+  }
 
+  // contiguous ranges of used registers, none longer than one request
+  for (uint16_t r = 0; r < REGISTER_IMAGE_SIZE; r++)
+  {
+    if (!used[r])
+      continue;
+    if (ranges == 0 || rangeEnd[ranges - 1] != r - 1 || r - rangeStart[ranges - 1] >= MODBUS_MAX_REQUEST_SIZE)
+    {
+      rangeStart[ranges] = r;
+      ranges++;
+    }
+    rangeEnd[ranges - 1] = r;
+  }
 
-  if (result == growattInterface.ku8MBSuccess)   
+  // cost[j]: least bytes on the wire to read ranges 0..j-1, first[j]: first range of the last request
+  cost[0] = 0;
+  for (uint8_t j = 1; j <= ranges; j++)
   {
-    // register 0-63
-    //  Status and PV data
-    modbusdata.status = growattInterface.getResponseBuffer(0);
-    modbusdata.solarpower = ((growattInterface.getResponseBuffer(1) << 16) | growattInterface.getResponseBuffer(2)) * 0.1;
+    cost[j] = UINT32_MAX;
+    for (uint8_t i = j; i > 0 && rangeEnd[j - 1] - rangeStart[i - 1] < MODBUS_MAX_REQUEST_SIZE; i--)
+    {
+      uint32_t c = cost[i - 1] + requestCost + 2 * (rangeEnd[j - 1] - rangeStart[i - 1] + 1);
+      if (c < cost[j])
+      {
+        cost[j] = c;
+        first[j] = i - 1;
+      }
+    }
+  }
 
-    modbusdata.pv1voltage = growattInterface.getResponseBuffer(3) * 0.1;
-    modbusdata.pv1current = growattInterface.getResponseBuffer(4) * 0.1;
-    modbusdata.pv1power = ((growattInterface.getResponseBuffer(5) << 16) | growattInterface.getResponseBuffer(6)) * 0.1;
+  // walk back from the last range, then restore the ascending order
+  for (uint8_t j = ranges; j > 0 && size < MAX_REGISTER_REQUESTS; j = first[j])
+  {
+    plan[size].start = rangeStart[first[j]];
+    plan[size].count = rangeEnd[j - 1] - rangeStart[first[j]] + 1;
+    size++;
+  }
+  for (uint8_t i = 0; i < size / 2; i++)
+  {
+    registerRequest tmp = plan[i];
+    plan[i] = plan[size - 1 - i];
+    plan[size - 1 - i] = tmp;
+  }
+  return size;
+}
 
-    modbusdata.pv2voltage = growattInterface.getResponseBuffer(7) * 0.1;
-    modbusdata.pv2current = growattInterface.getResponseBuffer(8) * 0.1;
-    modbusdata.pv2power = ((growattInterface.getResponseBuffer(9) << 16) | growattInterface.getResponseBuffer(10)) * 0.1;
+// Input register groups of the inverter due on this Modbus update, bit mask of registerGroup.
+// A group the other master on a shared bus read since the last update is fresh already.
+uint8_t growattIF::dueGroups(const inverterState &inverter) {
+  uint8_t groups = 0;
 
-    // Output
-    modbusdata.outputpower = ((growattInterface.getResponseBuffer(35) << 16) | growattInterface.getResponseBuffer(36)) * 0.1;
-    modbusdata.gridfrequency = growattInterface.getResponseBuffer(37) * 0.01;
-    modbusdata.gridvoltage = growattInterface.getResponseBuffer(38) * 0.1;
+  for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+  {
+    if (g != grpSettings && !(inverter.foreignGroups & (1 << g)) && inverter.groupAge[g] + 1 >= registerGroups[g].divider)
+      groups |= 1 << g;
+  }
+  return groups;
+}
 
-    // Energy
-    modbusdata.energytoday = ((growattInterface.getResponseBuffer(53) << 16) | growattInterface.getResponseBuffer(54)) * 0.1;
-    modbusdata.energytotal = ((growattInterface.getResponseBuffer(55) << 16) | growattInterface.getResponseBuffer(56)) * 0.1;
-    modbusdata.totalworktime = ((growattInterface.getResponseBuffer(57) << 16) | growattInterface.getResponseBuffer(58)) * 0.5;
+// Packs the due groups into the input plan by priority, as long as the window of
+// MODBUS_WINDOW_REQUESTS holds them. A group left out stays due for the next update.
+uint8_t growattIF::scheduleGroups(inverterState &inverter) {
+  uint8_t due = dueGroups(inverter);
+  uint8_t groups = 0;
 
-    modbusdata.pv1energytoday = ((growattInterface.getResponseBuffer(59) << 16) | growattInterface.getResponseBuffer(60)) * 0.1;
-    modbusdata.pv1energytotal = ((growattInterface.getResponseBuffer(61) << 16) | growattInterface.getResponseBuffer(62)) * 0.1;
-    overflow = growattInterface.getResponseBuffer(63);
+  for (uint8_t priority = 0; priority < REGISTER_GROUPS; priority++)
+  {
+    for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+    {
+      if (registerGroups[g].priority != priority || !(due & (1 << g)))
+        continue;
+      uint8_t candidate = groups | (1 << g);
+      if (groups == 0 || planRequests(inputRegisterMap, INPUT_REGISTER_COUNT, candidate, inputPlan) <= MODBUS_WINDOW_REQUESTS)
+        groups = candidate;
+    }
   }
-  else
+  for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
   {
-      return result;
-  }
-  delay(10); // if not bus error occours
-  // next register block
-  #ifndef ARDUINO_ESP32_DEV
-  ESP.wdtDisable();
-  #else
-    result = growattInterface.readInputRegisters(1 * 64, 64);
-  #endif
-
-  #ifndef ARDUINO_ESP32_DEV
-    ESP.wdtEnable(1);
-  #endif
-
-  if (result == growattInterface.ku8MBSuccess) 
-  { // register 64 -127
-      modbusdata.pv2energytoday = ((overflow << 16) | growattInterface.getResponseBuffer(64 - 64)) * 0.1;
-      modbusdata.pv2energytotal = ((growattInterface.getResponseBuffer(65 - 64) << 16) | growattInterface.getResponseBuffer(66 - 64)) * 0.1;
-
-      // Temperatures
-      modbusdata.tempinverter = growattInterface.getResponseBuffer(93 - 64) * 0.1;
-      modbusdata.tempipm = growattInterface.getResponseBuffer(94 - 64) * 0.1;
-      modbusdata.tempboost = growattInterface.getResponseBuffer(95 - 64) * 0.1;
-
-      // Diag data
-      modbusdata.ipf = growattInterface.getResponseBuffer(100 - 64);
-      modbusdata.realoppercent = growattInterface.getResponseBuffer(101 - 64);
-      modbusdata.opfullpower = ((growattInterface.getResponseBuffer(102 - 64) << 16) | growattInterface.getResponseBuffer(103 - 64)) * 0.1;
-      modbusdata.deratingmode = growattInterface.getResponseBuffer(103 - 64);
-      //  0:no derate;
-      //  1:PV;
-      //  2:*;
-      //  3:Vac;
-      //  4:Fac;
-      //  5:Tboost;
-      //  6:Tinv;
-      //  7:Control;
-      //  8:*;
-      //  9:*OverBack
-      //  ByTime;
-
-      modbusdata.faultcode = growattInterface.getResponseBuffer(105 - 64);
-      //  1~23 " Error: 99+x
-      //  24 "Auto Test
-      //  25 "No AC
-      //  26 "PV Isolation Low"
-      //  27 " Residual I
-      //  28 " Output High
-      //  29 " PV Voltage
-      //  30 " AC V Outrange
-      //  31 " AC F Outrange
-      //  32 " Module Hot
-
-
-      modbusdata.faultbitcode = ((growattInterface.getResponseBuffer(106 - 64) << 16) | growattInterface.getResponseBuffer(107 - 64));
-      //  0x00000001 
-      //  0x00000002 Communication error
-      //  0x00000004 
-      //  0x00000008 StrReverse or StrShort fault
-      //  0x00000010 Model Init fault
-      //  0x00000020 Grid Volt Sample diffirent
-      //  0x00000040 ISO Sample diffirent
-      //  0x00000080 GFCI Sample diffirent
-      //  0x00000100 
-      //  0x00000200 
-      //  0x00000400 
-      //  0x00000800 
-      //  0x00001000 AFCI Fault
-      //  0x00002000 
-      //  0x00004000 AFCI Module fault
-      //  0x00008000 
-      //  0x00010000 
-      //  0x00020000 Relay check fault
-      //  0x00040000 
-      //  0x00080000 
-      //  0x00100000 
-      //  0x00200000 Communication error
-      //  0x00400000 Bus Voltage error
-      //  0x00800000 AutoTest fail
-      //  0x01000000 No Utility
-      //  0x02000000 PV Isolation Low
-      //  0x04000000 Residual I High
-      //  0x08000000 Output High DCI
-      //  0x10000000 PV Voltage high
-      //  0x20000000 AC V Outrange
-      //  0x40000000 AC F Outrange
-      //  0x80000000 TempratureHigh
-
-      modbusdata.warningbitcode = ((growattInterface.getResponseBuffer(110 - 64) << 16) | growattInterface.getResponseBuffer(111 - 64));
-      //  0x0001 Fan warning
-      //  0x0002 String communication abnormal
-      //  0x0004 StrPIDconfig Warning
-      //  0x0008 
-      //  0x0010 DSP and COM firmware unmatch
-      //  0x0020 
-      //  0x0040 SPD abnormal
-      //  0x0080 GND and N connect abnormal
-      //  0x0100 PV1 or PV2 circuit short
-      //  0x0200 PV1 or PV2 boost driver broken
-      //  0x0400 
-      //  0x0800 
-      //  0x1000 
-      //  0x2000 
-      //  0x4000 
-      //  0x8000
+    if (inverter.groupAge[g] < UINT8_MAX)
+      inverter.groupAge[g]++;
   }
-  else
+  inverter.foreignGroups = 0;
+  inputPlanSize = planRequests(inputRegisterMap, INPUT_REGISTER_COUNT, groups, inputPlan);
+  return groups;
+}
+
+// Start reading the input registers of the due groups of the inverter, the read is advanced by poll().
+// Each call is one Modbus update of the group scheduler of that inverter.
+uint8_t growattIF::beginReadInputRegisters(uint8_t inverter) {
+  if (jobResult == Pending)
+  {
+    return Pending;
+  }
+  jobGroups = scheduleGroups(inverters[inverter]);
+  beginJob(inverter, false);
+  if (inputPlanSize == 0)
   {
-      return result;
+    jobResult = Success;          // every due group came with the responses to the other master
   }
-  
   return Success;
 }
 
-#define TMP_BUFFER_SIZE  50
+// Start reading the holding registers of the inverter, the read is advanced by poll()
+uint8_t growattIF::beginReadHoldingRegisters(uint8_t inverter) {
+  if (jobResult == Pending)
+  {
+    return Pending;
+  }
+  jobGroups = 1 << grpSettings;
+  return beginJob(inverter, true);
+}
+
+// The inverters share the bus: no transaction is pending between two jobs, so the slave ID
+// is switched here
+uint8_t growattIF::beginJob(uint8_t inverter, bool holding) {
+  if (jobResult == Pending)
+  {
+    return Pending;
+  }
+  jobInverter = inverter;
+  growattInterface.setSlave(slaveIds[inverter]);
+  jobHolding = holding;
+  jobWriting = false;
+  jobBlock = 0;
+  jobRetries = 0;
+  jobResult = Pending;
+  return Success;
+}
 
-void growattIF::InputRegistersToJson(char* json)
-{
-  // Generate the modbus MQTT message
-  char tmp_json[TMP_BUFFER_SIZE];
-
-  strcpy(json, "{");
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"status\":%d,", modbusdata.status);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"solarpower\":%.1f,", modbusdata.solarpower);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv1voltage\":%.1f,", modbusdata.pv1voltage);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv1current\":%.1f,", modbusdata.pv1current);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv1power\":%.1f,", modbusdata.pv1power);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv2voltage\":%.1f,", modbusdata.pv2voltage);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv2current\":%.1f,", modbusdata.pv2current);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv2power\":%.1f,", modbusdata.pv2power);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"outputpower\":%.1f,", modbusdata.outputpower);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridfrequency\":%.2f,", modbusdata.gridfrequency);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridvoltage\":%.1f,", modbusdata.gridvoltage);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"energytoday\":%.1f,", modbusdata.energytoday);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"energytotal\":%.1f,", modbusdata.energytotal);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"totalworktime\":%.1f,", modbusdata.totalworktime);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv1energytoday\":%.1f,", modbusdata.pv1energytoday);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv1energytotal\":%.1f,", modbusdata.pv1energytotal);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv2energytoday\":%.1f,", modbusdata.pv2energytoday);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"pv2energytotal\":%.1f,", modbusdata.pv2energytotal);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"opfullpower\":%.1f,", modbusdata.opfullpower);
-  strcat(json, tmp_json);
-
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"tempinverter\":%.1f,", modbusdata.tempinverter);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"tempipm\":%.1f,", modbusdata.tempipm);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"tempboost\":%.1f,", modbusdata.tempboost);
-  strcat(json, tmp_json);
-
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"ipf\":%d,", modbusdata.ipf);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"realoppercent\":%d,", modbusdata.realoppercent);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"deratingmode\":%d,", modbusdata.deratingmode);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"faultcode\":%d,", modbusdata.faultcode);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"faultbitcode\":%d,", modbusdata.faultbitcode);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"warningbitcode\":%d}", modbusdata.warningbitcode);
-  strcat(json, tmp_json);
-}  
-
-  uint8_t growattIF::ReadHoldingRegisters()
-  {
-    uint8_t result;
-    
-#ifndef ARDUINO_ESP32_DEV
-    ESP.wdtDisable();
-    result = growattInterface.readHoldingRegisters(0 * 64, 64);
-    ESP.wdtEnable(1);
-#else
-    result = growattInterface.readHoldingRegisters(0 * 64, 64);
-#endif 
+// Queues a holding register write of the inverter for beginWrite(). When the last queued write that covers the register
+// is a single write with holdTime 0, it takes the new value instead, so only the latest value of e.g. a slider reaches
+// the inverter. A later write to the register, e.g. in a block, keeps the order and the new value is queued behind it.
+// holdTime keeps the bus silent after the write, e.g. while the inverter restarts.
+uint8_t growattIF::queueWrite(uint8_t inverter, uint16_t reg, uint16_t value, uint16_t holdTime) {
+#ifdef MODBUS_LISTEN_ONLY
+  return ListenOnly;                  // a listener never sends
+#endif
+  // the first write is on the bus while a write job runs
+  uint8_t first = (jobWriting && jobResult == Pending) ? 1 : 0;
 
-    if (result == growattInterface.ku8MBSuccess)
+  if (holdTime == 0)
+  {
+    for (uint8_t i = writeCount; i > first; i--)
     {
-      // register 0-63
-        modbussettings.enable = growattInterface.getResponseBuffer(0);
-        modbussettings.safetyfuncen = growattInterface.getResponseBuffer(1); // Safety Function Enabled
-        //  Bit0: SPI enable
-        //  Bit1: AutoTestStart
-        //  Bit2: LVFRT enable
-        //  Bit3: FreqDerating Enable
-        //  Bit4: Softstart enable
-        //  Bit5: DRMS enable
-        //  Bit6: Power Volt Func Enable
-        //  Bit7: HVFRT enable
-        //  Bit8: ROCOF enable
-        //  Bit9: Recover FreqDerating Mode Enable
-        //  Bit10~15: Reserved
-        modbussettings.maxoutputactivepp = growattInterface.getResponseBuffer(3);   // Inverter M ax output active power percent  0-100: %, 255: not limited
-        modbussettings.maxoutputreactivepp = growattInterface.getResponseBuffer(4); // Inverter M ax output reactive power percent  0-100: %, 255: not limited
-        modbussettings.maxpower = ((growattInterface.getResponseBuffer(6) << 16) | growattInterface.getResponseBuffer(7)) * 0.1;
-        modbussettings.voltnormal = growattInterface.getResponseBuffer(8) * 0.1;
-
-        modbussettings.firmware[0] = growattInterface.getResponseBuffer(9) >> 8;
-        modbussettings.firmware[1] = growattInterface.getResponseBuffer(9) & 0xff;
-        modbussettings.firmware[2] = growattInterface.getResponseBuffer(10) >> 8;
-        modbussettings.firmware[3] = growattInterface.getResponseBuffer(10) & 0xff;
-        modbussettings.firmware[4] = growattInterface.getResponseBuffer(11) >> 8;
-        modbussettings.firmware[5] = growattInterface.getResponseBuffer(11) & 0xff;
-        modbussettings.firmware[6] = '\0';
-
-        modbussettings.controlfirmware[0] = growattInterface.getResponseBuffer(12) >> 8;
-        modbussettings.controlfirmware[1] = growattInterface.getResponseBuffer(12) & 0xff;
-        modbussettings.controlfirmware[2] = growattInterface.getResponseBuffer(13) >> 8;
-        modbussettings.controlfirmware[3] = growattInterface.getResponseBuffer(13) & 0xff;
-        modbussettings.controlfirmware[4] = growattInterface.getResponseBuffer(14) >> 8;
-        modbussettings.controlfirmware[5] = growattInterface.getResponseBuffer(14) & 0xff;
-        modbussettings.controlfirmware[6] = '\0';
-
-        modbussettings.startvoltage = growattInterface.getResponseBuffer(17) * 0.1;
-
-        modbussettings.serial[0] = growattInterface.getResponseBuffer(23) >> 8;
-        modbussettings.serial[1] = growattInterface.getResponseBuffer(23) & 0xff;
-        modbussettings.serial[2] = growattInterface.getResponseBuffer(24) >> 8;
-        modbussettings.serial[3] = growattInterface.getResponseBuffer(24) & 0xff;
-        modbussettings.serial[4] = growattInterface.getResponseBuffer(25) >> 8;
-        modbussettings.serial[5] = growattInterface.getResponseBuffer(25) & 0xff;
-        modbussettings.serial[6] = growattInterface.getResponseBuffer(26) >> 8;
-        modbussettings.serial[7] = growattInterface.getResponseBuffer(26) & 0xff;
-        modbussettings.serial[8] = growattInterface.getResponseBuffer(27) >> 8;
-        modbussettings.serial[9] = growattInterface.getResponseBuffer(27) & 0xff;
-        modbussettings.serial[10] = '\0';
-
-        modbussettings.gridvoltlowlimit = growattInterface.getResponseBuffer(52) * 0.1;
-        modbussettings.gridvolthighlimit = growattInterface.getResponseBuffer(53) * 0.1;
-        modbussettings.gridfreqlowlimit = growattInterface.getResponseBuffer(54) * 0.01;
-        modbussettings.gridfreqhighlimit = growattInterface.getResponseBuffer(55) * 0.01;
+      registerWrite &queued = writeQueue[(writeHead + i - 1) % WRITE_QUEUE_SIZE];
+      if (queued.inverter != inverter || reg < queued.reg || reg >= queued.reg + queued.count)
+        continue;
+      if (queued.count == 1 && queued.holdTime == 0)
+      {
+        queued.values[0] = value;
+        return Success;
+      }
+      break;
     }
-    else
+  }
+  if (writeCount == WRITE_QUEUE_SIZE)
+  {
+    return QueueFull;
+  }
+  registerWrite &write = writeQueue[(writeHead + writeCount) % WRITE_QUEUE_SIZE];
+  write.inverter = inverter;
+  write.reg = reg;
+  write.count = 1;
+  write.holdTime = holdTime;
+  write.values[0] = value;
+  writeCount++;
+  return Success;
+}
+
+// Queues the contiguous registers reg .. reg + count - 1 as one multiple register write (0x10), so the
+// inverter never sees a part of them changed. The job reads them back (0x03) right after the write
+// and fails with VerifyFailed when they differ.
+uint8_t growattIF::queueWrite(uint8_t inverter, uint16_t reg, const uint16_t *values, uint8_t count) {
+#ifdef MODBUS_LISTEN_ONLY
+  return ListenOnly;
+#endif
+  if (count == 0 || count > WRITE_BLOCK_SIZE)
+  {
+    return ModbusMaster::ku8MBIllegalDataValue;
+  }
+  if (count == 1)
+  {
+    return queueWrite(inverter, reg, values[0]);
+  }
+  if (writeCount == WRITE_QUEUE_SIZE)
+  {
+    return QueueFull;
+  }
+  registerWrite &write = writeQueue[(writeHead + writeCount) % WRITE_QUEUE_SIZE];
+  write.inverter = inverter;
+  write.reg = reg;
+  write.count = count;
+  write.holdTime = 0;
+  memcpy(write.values, values, count * sizeof(values[0]));
+  writeCount++;
+  return Success;
+}
+
+uint8_t growattIF::writesQueued() {
+  return writeCount;
+}
+
+// Start the oldest queued write, it is advanced by poll() like a read
+uint8_t growattIF::beginWrite() {
+  if (jobResult == Pending)
+  {
+    return Pending;
+  }
+  if (writeCount == 0)
+  {
+    return Success;
+  }
+  jobGroups = 0;
+  beginJob(writeQueue[writeHead].inverter, false);
+  jobWriting = true;
+  jobVerifying = false;
+  return Success;
+}
+
+// Advances the running read or write job without blocking: sends the request of the next planned block once the
+// bus had its idle time, collects the response bytes that have arrived and decodes the registers
+// after the last block.
+void growattIF::poll() {
+  uint32_t start = micros();
+
+#ifdef MODBUS_SHARED_BUS
+  if (!growattInterface.transactionPending())
+  {
+    listen();
+  }
+#endif
+  pollJob();
+  inverters[jobInverter].statistics.cpuTime += micros() - start;
+}
+
+void growattIF::pollJob() {
+  uint8_t result;
+  inverterState &inverter = inverters[jobInverter];
+  const registerRequest &request = jobHolding ? holdingPlan[jobBlock] : inputPlan[jobBlock];
+  uint16_t *image = jobHolding ? inverter.holdingImage : inverter.inputImage;
+
+  if (jobResult != Pending)
+  {
+    return;
+  }
+  if (jobWriting)
+  {
+    pollWrite();
+    return;
+  }
+
+  if (!growattInterface.transactionPending())
+  {
+    if (!busIdle())
     {
-     return result;
+      return;
     }
-    delay(10);
-#ifndef ARDUINO_ESP32_DEV
-    ESP.wdtDisable();
-    result = growattInterface.readHoldingRegisters(1 * 64, 64);
-    ESP.wdtEnable(1);
-#else
-    result = growattInterface.readHoldingRegisters(1 * 64, 64);
+    if (jobHolding)
+      growattInterface.startReadHoldingRegisters(request.start, request.count);
+    else
+      growattInterface.startReadInputRegisters(request.start, request.count);
+    return;
+  }
+
+  result = growattInterface.pollTransaction();
+  if (result == Pending)
+  {
+    return;
+  }
+  jobNextRequest = millis() + MODBUS_REQUEST_GAP;
+  countResult(result);
+#ifdef MODBUS_SHARED_BUS
+  // the other master talked into the response: ask again once the bus is idle. A timeout is no collision,
+  // a silent inverter fails after the response timeout instead of twice that.
+  if ((result == growattInterface.ku8MBInvalidCRC || result == growattInterface.ku8MBInvalidSlaveID ||
+       result == growattInterface.ku8MBInvalidFunction) && jobRetries < COLLISION_RETRIES)
+  {
+    jobRetries++;
+    sniffer.collision();
+    return;
+  }
 #endif
+  if (result != growattInterface.ku8MBSuccess)
+  {
+    jobResult = result;
+    return;
+  }
 
-    if (result == growattInterface.ku8MBSuccess)
+  jobRetries = 0;
+  for (uint8_t i = 0; i < request.count; i++)
+  {
+    image[request.start + i] = growattInterface.getResponseBuffer(i);
+  }
+  if (++jobBlock < (jobHolding ? holdingPlanSize : inputPlanSize))
+  {
+    return;
+  }
+
+  if (jobHolding)
+    decodeRegisters(holdingRegisterMap, HOLDING_REGISTER_COUNT, inverter.holdingImage, inverter.modbussettings);
+  else
+    decodeRegisters(inputRegisterMap, INPUT_REGISTER_COUNT, inverter.inputImage, inverter.modbusdata);
+  for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+  {
+    if (jobGroups & (1 << g))
     {
-     // register 64 -127
-      modbussettings.gridvoltlowconnlimit = growattInterface.getResponseBuffer(64 - 64) * 0.1;
-      modbussettings.gridvolthighconnlimit = growattInterface.getResponseBuffer(65 - 64) * 0.1;
-      modbussettings.gridfreqlowconnlimit = growattInterface.getResponseBuffer(66 - 64) * 0.01;
-      modbussettings.gridfreqhighconnlimit = growattInterface.getResponseBuffer(67 - 64) * 0.01;
+      inverter.groupAge[g] = 0;
+      inverter.groupReads[g]++;
+    }
+  }
+  jobResult = Success;
+}
 
-      modbussettings.modul = growattInterface.getResponseBuffer(121 - 64);
+void growattIF::pollWrite() {
+  uint8_t result;
+  const registerWrite &write = writeQueue[writeHead];
+
+  if (!growattInterface.transactionPending())
+  {
+    if (!busIdle())
+    {
+      return;
     }
-    else
+    if (jobVerifying)
+    {
+      growattInterface.startReadHoldingRegisters(write.reg, write.count);
+    }
+    else if (write.count == 1)
     {
-      return result;
+      growattInterface.startWriteSingleRegister(write.reg, write.values[0]);
     }
-    /*{ // register 128-191
-        //          //          modbussettings.modul = growattInterface.getResponseBuffer(130 - 128);
-    
-    //}
     else
     {
-      return result;
-    }*/
-    return Success;
+      for (uint8_t i = 0; i < write.count; i++)
+      {
+        growattInterface.setTransmitBuffer(i, write.values[i]);
+      }
+      growattInterface.startWriteMultipleRegisters(write.reg, write.count);
+    }
+    return;
+  }
+
+  result = growattInterface.pollTransaction();
+  if (result == Pending)
+  {
+    return;
+  }
+  jobNextRequest = millis() + MODBUS_REQUEST_GAP;
+  countResult(result);
+  if (result == Success && write.count > 1 && !jobVerifying)
+  {
+    // read back next, before any other request
+    jobVerifying = true;
+    return;
+  }
+  if (result == Success && jobVerifying)
+  {
+    for (uint8_t i = 0; i < write.count; i++)
+    {
+      if (growattInterface.getResponseBuffer(i) != write.values[i])
+        result = VerifyFailed;
+    }
+  }
+  jobNextRequest += write.holdTime;
+  jobVerifying = false;
+  writeHead = (writeHead + 1) % WRITE_QUEUE_SIZE;
+  writeCount--;
+  jobResult = result;
+}
+
+// true when a request may be sent: the gap after the last response has passed and, on a shared bus,
+// the other master is not talking
+bool growattIF::busIdle() {
+  if ((int32_t)(millis() - jobNextRequest) < 0)
+  {
+    return false;
+  }
+#ifdef MODBUS_SHARED_BUS
+  return sniffer.idle(MODBUS_REQUEST_GAP);
+#else
+  return true;
+#endif
 }
 
-void growattIF::HoldingRegistersToJson(char *json)
+#ifdef MODBUS_SHARED_BUS
+// Takes the registers of the responses to the other master into the register image of the inverter.
+// An input register group whose registers all came along is not read on the next update. A response
+// without a register of the map, e.g. beyond the image, leaves the inverter as it was.
+void growattIF::listen() {
+  uint8_t i;
+  uint16_t start, end;
+  uint16_t *image;
+  bool holding;
+  const registerDescriptor *map;
+  uint8_t count;
+  bool mapped = false;
+
+  if (!sniffer.poll(*port))
+  {
+    return;
+  }
+  for (i = 0; i < INVERTERS && slaveIds[i] != sniffer.slave(); i++);
+  if (i == INVERTERS)
+  {
+    return;
+  }
+  inverterState &inverter = inverters[i];
+  holding = sniffer.function() == 0x03;
+  image = holding ? inverter.holdingImage : inverter.inputImage;
+  map = holding ? holdingRegisterMap : inputRegisterMap;
+  count = holding ? HOLDING_REGISTER_COUNT : INPUT_REGISTER_COUNT;
+  start = sniffer.start();
+  end = start + sniffer.count();
+  for (uint8_t r = 0; r < count && !mapped; r++)
+  {
+    mapped = map[r].address < end && map[r].address + map[r].width > start;
+  }
+  if (!mapped)
+  {
+    return;
+  }
+  for (uint16_t r = start; r < end && r < REGISTER_IMAGE_SIZE; r++)
+  {
+    image[r] = sniffer.value(r - start);
+  }
+  inverter.statistics.foreignReads++;
+  if (holding)
+  {
+    decodeRegisters(holdingRegisterMap, HOLDING_REGISTER_COUNT, inverter.holdingImage, inverter.modbussettings);
+    heardHolding |= 1 << i;
+  }
+  else
+  {
+    decodeRegisters(inputRegisterMap, INPUT_REGISTER_COUNT, inverter.inputImage, inverter.modbusdata);
+    heardInput |= 1 << i;
+    for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+    {
+      bool covered = g != grpSettings;
+      for (uint8_t r = 0; r < INPUT_REGISTER_COUNT && covered; r++)
+      {
+        const registerDescriptor &reg = inputRegisterMap[r];
+        if (reg.group == g && (reg.address < start || reg.address + reg.width > end))
+          covered = false;
+      }
+      if (covered)
+      {
+        inverter.foreignGroups |= 1 << g;
+        inverter.groupAge[g] = 0;
+        inverter.groupReads[g]++;
+      }
+    }
+  }
+
+  uint32_t latency = micros() - sniffer.frameEnd();
+  decodeStatistics.decodes++;
+  decodeStatistics.decodeTime += latency;
+  if (latency > decodeStatistics.decodeTimeMax)
+    decodeStatistics.decodeTimeMax = latency;
+}
+
+// Inverters whose input (or holding) registers came with the responses to the other master since the
+// last call, bit mask
+uint8_t growattIF::heard(bool holding) {
+  uint8_t &mask = holding ? heardHolding : heardInput;
+  uint8_t inverters = mask;
+
+  mask = 0;
+  return inverters;
+}
+#endif
+
+void growattIF::countResult(uint8_t result) {
+  modbus_statistics &statistics = inverters[jobInverter].statistics;
+
+  statistics.requests++;
+  if (result == growattInterface.ku8MBInvalidCRC)
+    statistics.crcErrors++;
+  else if (result == growattInterface.ku8MBResponseTimedOut)
+    statistics.timeouts++;
+  else if (result != growattInterface.ku8MBSuccess)
+    statistics.otherErrors++;
+}
+
+// true when no read job is running
+bool growattIF::done() {
+  return jobResult != Pending;
+}
+
+// result of the last read job, Success or the Modbus error
+uint8_t growattIF::result() {
+  return jobResult;
+}
+
+// inverter of the running or last job, index into slaveIds
+uint8_t growattIF::inverter() {
+  return jobInverter;
+}
+
+// Finish the running read job, needed before a blocking transaction
+void growattIF::waitDone() {
+  while (!done())
+  {
+    poll();
+    yield();
+  }
+}
+
+uint8_t growattIF::ReadInputRegisters(uint8_t inverter) {
+  waitDone();
+  beginReadInputRegisters(inverter);
+  waitDone();
+  return jobResult;
+}
+
+#define STATISTICS_JSON_LENGTH  256
+
+// Published value in units of 10^-decimals, rounded half away from zero when decimals is less than
+// the exponent. Integer arithmetic only, 64 bit so that 32 bit counters keep every digit.
+int64_t growattIF::fixedValue(const registerDescriptor &reg, int32_t value)
+{
+  static const uint16_t pow10[] = { 1, 10, 100, 1000 };
+  int64_t fixed = reg.isSigned ? (int64_t)value : (int64_t)(uint32_t)value;
+
+  fixed *= reg.multiplier;
+  if (reg.decimals >= reg.exponent)
+  {
+    fixed *= pow10[reg.decimals - reg.exponent];
+  }
+  else
+  {
+    int64_t divisor = pow10[reg.exponent - reg.decimals];
+    fixed = (fixed < 0) ? (fixed - divisor / 2) / divisor : (fixed + divisor / 2) / divisor;
+  }
+  return fixed;
+}
+
+// Writes the fields of the map as JSON object, only the selected ones when selected is not NULL.
+// Returns the number of fields written.
+uint8_t growattIF::registersToJson(const registerDescriptor *map, uint8_t count, const uint16_t *image, const int32_t *values, const bool *selected, jsonWriter &writer)
 {
-  
-  char tmp_json[TMP_BUFFER_SIZE];
+  char text[2 * 5 + 1];     // longest ASCII field is the 10 character serial number
+  uint8_t fields = 0;
 
   // Generate the modbus MQTT message
-  strcpy(json, "{");
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"enable\":%d,", modbussettings.enable);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"safetyfuncen\":%d,", modbussettings.safetyfuncen);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"maxoutputactivepp\":%d,", modbussettings.maxoutputactivepp);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"maxoutputreactivepp\":%d,", modbussettings.maxoutputreactivepp);
-  strcat(json, tmp_json);
-
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"maxpower\":%.1f,", modbussettings.maxpower);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"voltnormal\":%.1f,", modbussettings.voltnormal);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"startvoltage\":%.1f,", modbussettings.startvoltage);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridvoltlowlimit\":%.1f,", modbussettings.gridvoltlowlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridvolthighlimit\":%.1f,", modbussettings.gridvolthighlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridfreqlowlimit\":%.1f,", modbussettings.gridfreqlowlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridfreqhighlimit\":%.1f,", modbussettings.gridfreqhighlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridvoltlowconnlimit\":%.1f,", modbussettings.gridvoltlowconnlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridvolthighconnlimit\":%.1f,", modbussettings.gridvolthighconnlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridfreqlowconnlimit\":%.1f,", modbussettings.gridfreqlowconnlimit);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"gridfreqhighconnlimit\":%.1f,", modbussettings.gridfreqhighconnlimit);
-  strcat(json, tmp_json);
-
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"firmware\":\"%s\",", modbussettings.firmware);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"controlfirmware\":\"%s\",", modbussettings.controlfirmware);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"serial\":\"%s\",", modbussettings.serial);
-  strcat(json, tmp_json);
-  snprintf(tmp_json, TMP_BUFFER_SIZE, "\"modulPower\":\"%04X\"}", modbussettings.modul);
-  strcat(json, tmp_json);
+  writer.append('{');
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const registerDescriptor &reg = map[i];
+
+    if (selected && !selected[i])
+      continue;
+    if (fields)
+      writer.append(',');
+    writer.appendKey(reg.name);
+    switch (reg.format)
+    {
+      case fmtAscii:
+        for (uint8_t w = 0; w < reg.width; w++)
+        {
+          text[2 * w] = image[reg.address + w] >> 8;
+          text[2 * w + 1] = image[reg.address + w] & 0xff;
+        }
+        text[2 * reg.width] = '\0';
+        writer.appendString(text);
+        break;
+      case fmtHex:
+        writer.append('"');
+        writer.appendHex(values[i]);
+        writer.append('"');
+        break;
+      default:
+        writer.appendFixed(fixedValue(reg, values[i]), reg.decimals);
+        break;
+    }
+    fields++;
+  }
+  writer.append('}');
+  return fields;
 }
 
+#ifdef PUBLISH_MSGPACK
+// Same fields as registersToJson() as ArduinoJson document, for the binary MessagePack message. Numbers with
+// decimals become floating point, the keys point into the map and are not copied. ASCII fields are left out.
+void growattIF::registersToDocument(const registerDescriptor *map, uint8_t count, const int32_t *values, const bool *selected, JsonObject object)
+{
+  static const uint16_t pow10[] = { 1, 10, 100, 1000 };
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const registerDescriptor &reg = map[i];
+
+    if (selected && !selected[i])
+      continue;
+    switch (reg.format)
+    {
+      case fmtAscii:
+        break;
+      case fmtHex:
+        object[reg.name] = (uint16_t)values[i];
+        break;
+      default:
+        if (reg.decimals == 0 && reg.isSigned)
+          object[reg.name] = (int32_t)fixedValue(reg, values[i]);
+        else if (reg.decimals == 0)
+          object[reg.name] = (uint32_t)fixedValue(reg, values[i]);
+        else
+          object[reg.name] = (double)fixedValue(reg, values[i]) / pow10[reg.decimals];
+        break;
+    }
+  }
+}
+#endif
+
+// true when the value moved further from the published one than the deadband of the register
+bool growattIF::outsideDeadband(const registerDescriptor &reg, int32_t value, int32_t published)
+{
+  uint32_t delta = (value > published) ? (uint32_t)value - (uint32_t)published : (uint32_t)published - (uint32_t)value;
+  uint32_t threshold = (published < 0 ? -(uint32_t)published : (uint32_t)published) / 100 * reg.deadbandPercent;
+
+  if (threshold < reg.deadband)
+    threshold = reg.deadband;
+  return delta > threshold;
+}
+
+// Selects all input registers for InputRegistersToJson(), they become the reference of SelectInputChanges()
+void growattIF::SelectInputSnapshot(uint8_t inverter)
+{
+  inverterState &state = inverters[inverter];
+
+  memset(state.inputSelected, true, sizeof(state.inputSelected));
+  memcpy(state.publisheddata, state.modbusdata, sizeof(state.publisheddata));
+}
+
+// Selects only the input registers that left their deadband since they were last published.
+// Returns the number of fields, nothing needs to be sent when it is 0.
+uint8_t growattIF::SelectInputChanges(uint8_t inverter)
+{
+  inverterState &state = inverters[inverter];
+  uint8_t fields = 0;
+
+  for (uint8_t i = 0; i < INPUT_REGISTER_COUNT; i++)
+  {
+    state.inputSelected[i] = outsideDeadband(inputRegisterMap[i], state.modbusdata[i], state.publisheddata[i]);
+    if (state.inputSelected[i])
+    {
+      state.publisheddata[i] = state.modbusdata[i];
+      fields++;
+    }
+  }
+  return fields;
+}
+
+// The selected input registers. Writing has no side effects, so a message can be written twice:
+// once to count its length and once to the MQTT client.
+void growattIF::InputRegistersToJson(uint8_t inverter, jsonWriter &writer)
+{
+  const inverterState &state = inverters[inverter];
+
+  registersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, state.inputImage, state.modbusdata, state.inputSelected, writer);
+}
+
+// Packs the raw registers of the input map fields of the inverter into INPUT_SNAPSHOT_WORDS words, in map order
+void growattIF::InputSnapshot(uint8_t inverter, uint16_t *words)
+{
+  const uint16_t *image = inverters[inverter].inputImage;
+
+  for (uint8_t i = 0; i < INPUT_REGISTER_COUNT; i++)
+  {
+    for (uint8_t w = 0; w < inputRegisterMap[i].width; w++)
+    {
+      *words++ = image[inputRegisterMap[i].address + w];
+    }
+  }
+}
+
+// All input registers of a snapshot of InputSnapshot(), as InputRegistersToJson() writes them
+void growattIF::InputSnapshotToJson(const uint16_t *words, jsonWriter &writer)
+{
+  uint16_t image[REGISTER_IMAGE_SIZE];
+  int32_t values[INPUT_REGISTER_COUNT];
+
+  for (uint8_t i = 0; i < INPUT_REGISTER_COUNT; i++)
+  {
+    for (uint8_t w = 0; w < inputRegisterMap[i].width; w++)
+    {
+      image[inputRegisterMap[i].address + w] = *words++;
+    }
+  }
+  decodeRegisters(inputRegisterMap, INPUT_REGISTER_COUNT, image, values);
+  registersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, image, values, NULL, writer);
+}
+
+#ifdef PUBLISH_MSGPACK
+// The selected input registers, like InputRegistersToJson()
+void growattIF::InputRegistersToDocument(uint8_t inverter, JsonObject object)
+{
+  const inverterState &state = inverters[inverter];
+
+  registersToDocument(inputRegisterMap, INPUT_REGISTER_COUNT, state.modbusdata, state.inputSelected, object);
+}
+#endif
+
+uint8_t growattIF::ReadHoldingRegisters(uint8_t inverter)
+{
+  waitDone();
+  beginReadHoldingRegisters(inverter);
+  waitDone();
+  return jobResult;
+}
+
+void growattIF::HoldingRegistersToJson(uint8_t inverter, jsonWriter &writer)
+{
+  const inverterState &state = inverters[inverter];
+
+  registersToJson(holdingRegisterMap, HOLDING_REGISTER_COUNT, state.holdingImage, state.modbussettings, NULL, writer);
+}
+
+
+// Bus statistics of the inverter since the last call, to compare transports and settings.
+// "rates" holds the achieved reads per minute of each register group.
+void growattIF::StatisticsToJson(uint8_t inverter, char *json)
+{
+  jsonWriter writer(json, STATISTICS_JSON_LENGTH);
+  modbus_statistics &statistics = inverters[inverter].statistics;
+  uint16_t *groupReads = inverters[inverter].groupReads;
+  uint32_t elapsed = millis() - inverters[inverter].statisticsStart;
+
+  writer.append("{\"requests\":");
+  writer.appendUnsigned(statistics.requests);
+  writer.append(",\"crcErrors\":");
+  writer.appendUnsigned(statistics.crcErrors);
+  writer.append(",\"timeouts\":");
+  writer.appendUnsigned(statistics.timeouts);
+  writer.append(",\"otherErrors\":");
+  writer.appendUnsigned(statistics.otherErrors);
+  writer.append(",\"cpuTime\":");
+  writer.appendUnsigned(statistics.cpuTime);
+#ifdef MODBUS_SHARED_BUS
+  writer.append(",\"foreignReads\":");
+  writer.appendUnsigned(statistics.foreignReads);
+#endif
+  writer.append(",\"rates\":{");
+  for (uint8_t g = 0; g < REGISTER_GROUPS; g++)
+  {
+    if (g)
+      writer.append(',');
+    writer.appendKey(registerGroups[g].name);
+    // reads per minute with 2 decimals: reads * 60000 * 100 / elapsed, rounded
+    writer.appendFixed(elapsed ? ((uint64_t)groupReads[g] * 6000000 + elapsed / 2) / elapsed : 0, 2);
+    groupReads[g] = 0;
+  }
+  writer.append("}}");
+  memset(&statistics, 0, sizeof(statistics));
+  inverters[inverter].statisticsStart = millis();
+}
+
+#ifdef MODBUS_SHARED_BUS
+// Traffic of the other master since the last call: the frames seen and how long the registers of a response
+// waited until they were decoded. "frameRate" is in frames per minute.
+void growattIF::BusStatisticsToJson(char *json)
+{
+  jsonWriter writer(json, STATISTICS_JSON_LENGTH);
+  modbusSniffer::sniffer_statistics &frames = sniffer.statistics;
+  uint32_t elapsed = millis() - busStatisticsStart;
+  uint32_t count = frames.requests + frames.responses;
+
+  writer.append("{\"requests\":");
+  writer.appendUnsigned(frames.requests);
+  writer.append(",\"responses\":");
+  writer.appendUnsigned(frames.responses);
+  writer.append(",\"brokenFrames\":");
+  writer.appendUnsigned(frames.brokenFrames);
+  writer.append(",\"frameRate\":");
+  writer.appendFixed(elapsed ? ((uint64_t)count * 6000000 + elapsed / 2) / elapsed : 0, 2);
+  writer.append(",\"decodes\":");
+  writer.appendUnsigned(decodeStatistics.decodes);
+  writer.append(",\"decodeTime\":");
+  writer.appendUnsigned(decodeStatistics.decodes ? decodeStatistics.decodeTime / decodeStatistics.decodes : 0);
+  writer.append(",\"decodeTimeMax\":");
+  writer.appendUnsigned(decodeStatistics.decodeTimeMax);
+  writer.append('}');
+  memset(&frames, 0, sizeof(frames));
+  memset(&decodeStatistics, 0, sizeof(decodeStatistics));
+  busStatisticsStart = millis();
+}
+#endif
 
   String growattIF::sendModbusError(uint8_t result)
   {
@@ -464,6 +950,18 @@ void growattIF::HoldingRegistersToJson(char *json)
     {
         message = "Invalid CRC";
     }
+    if (result == QueueFull)
+    {
+        message = "Write queue full";
+    }
+    if (result == VerifyFailed)
+    {
+        message = "Read back differs from the written values";
+    }
+    if (result == ListenOnly)
+    {
+        message = "Listening only, nothing is sent to the inverter";
+    }
     if (message == "")
     {
         message = result;
@@ -0,0 +1,336 @@
+#include "growattSimulator.h"
+#include "util/crc16.h"
+
+growattSimulator::growattSimulator(const uint8_t *_slaveIds, uint8_t _slaves) {
+  slaveIds = _slaveIds;
+  slaves = _slaves;
+  requestLength = 0;
+  responseLength = 0;
+  responseIndex = 0;
+  requests = 0;
+  collided = false;
+  dataloggerPeriod = 0;
+  dataloggerNext = 0;
+  dataloggerStart = 0;
+  foreignLength = 0;
+  foreignRequestLength = 0;
+  foreignIndex = 0;
+  foreignStart = 0;
+  exchangeEnd = 0;
+  collisions = 0;
+  memset(inputRegisters, 0, sizeof(inputRegisters));
+  memset(holdingRegisters, 0, sizeof(holdingRegisters));
+
+  // Holding registers of a MIC 1500TL-X
+  holdingRegisters[0] = 1;                              // enable
+  holdingRegisters[3] = 100;                            // max output active power percent
+  holdingRegisters[4] = 255;                            // max output reactive power percent
+  holdingRegisters[7] = 15000;                          // max power 1500.0 W
+  holdingRegisters[8] = 1000;                           // normal work PV voltage 100.0 V
+  holdingRegisters[9] = ('A' << 8) | 'H';               // firmware
+  holdingRegisters[10] = ('1' << 8) | '.';
+  holdingRegisters[11] = ('0' << 8) | '2';
+  holdingRegisters[12] = ('Z' << 8) | 'A';              // control firmware
+  holdingRegisters[13] = ('B' << 8) | 'A';
+  holdingRegisters[14] = ('0' << 8) | '7';
+  holdingRegisters[17] = 800;                           // start voltage 80.0 V
+  for (uint8_t i = 0; i < 5; i++)                       // serial number
+  {
+    holdingRegisters[23 + i] = (('S' + i) << 8) | ('0' + i);
+  }
+  holdingRegisters[52] = 1840;                          // grid voltage limits
+  holdingRegisters[53] = 2640;
+  holdingRegisters[54] = 4750;                          // grid frequency limits
+  holdingRegisters[55] = 5150;
+  holdingRegisters[64] = 1960;
+  holdingRegisters[65] = 2530;
+  holdingRegisters[66] = 4950;
+  holdingRegisters[67] = 5010;
+  holdingRegisters[121] = 0x000F;                       // modul power 1500 W
+
+  // Input registers
+  inputRegisters[0] = 1;                                // status normal
+  inputRegisters[55] = 0x0100;                          // energy total 1677721.7 kWh, beyond the 24 bit
+  inputRegisters[56] = 0x0001;                          // mantissa of a float
+  inputRegisters[58] = 36000;                           // total work time
+  updateLiveValues();
+}
+
+// Let the PV values move a little on every request, so consecutive polls differ
+void growattSimulator::updateLiveValues() {
+  uint16_t pvVoltage = 3000 + (millis() / 100) % 200;   // 300.0 .. 319.9 V
+  uint16_t pvCurrent = 20 + (millis() / 1000) % 30;     // 2.0 .. 4.9 A
+  uint32_t pvPower = (uint32_t)pvVoltage * pvCurrent / 10;
+
+  inputRegisters[3] = pvVoltage;
+  inputRegisters[4] = pvCurrent;
+  inputRegisters[5] = pvPower >> 16;
+  inputRegisters[6] = pvPower & 0xffff;
+  inputRegisters[1] = pvPower >> 16;                    // solar power
+  inputRegisters[2] = pvPower & 0xffff;
+  inputRegisters[35] = (pvPower * 97 / 100) >> 16;      // output power
+  inputRegisters[36] = (pvPower * 97 / 100) & 0xffff;
+  inputRegisters[37] = 4990 + (millis() / 1000) % 20;   // grid frequency
+  inputRegisters[38] = 2300 + (millis() / 1000) % 50;   // grid voltage
+  inputRegisters[54] = (millis() / 60000) % 65536;      // energy today
+  inputRegisters[93] = 350 + (millis() / 10000) % 100;  // temperatures
+  inputRegisters[94] = inputRegisters[93] + 20;
+  inputRegisters[95] = inputRegisters[93] + 10;
+  inputRegisters[100] = 20000;                          // ipf
+  inputRegisters[101] = 100;                            // real output percent
+}
+
+// A second master reads the input registers of the first slave every period ms, one block of
+// dataloggerBlock registers after the other
+void growattSimulator::setDatalogger(uint16_t period) {
+  dataloggerPeriod = period;
+  dataloggerNext = millis() + period;
+}
+
+// Starts the datalogger exchange when it is due. It waits for the end of our exchange, like a master that
+// listens before it talks, but it does not wait for our next poll: it went on the wire when it was due.
+void growattSimulator::pollDatalogger() {
+  uint32_t now = micros();
+  uint32_t late;
+
+  if (dataloggerPeriod == 0 || foreignIndex < foreignLength || responseIndex < responseLength || requestLength != 0 ||
+      (int32_t)(millis() - dataloggerNext) < 0)
+  {
+    return;
+  }
+  late = (millis() - dataloggerNext) * 1000UL;
+  if (late > now - exchangeEnd)
+  {
+    late = now - exchangeEnd;
+  }
+  startDatalogger();
+  foreignStart = now - late;
+}
+
+void growattSimulator::startDatalogger() {
+  uint16_t start = dataloggerStart;
+  uint16_t count = min((uint16_t)dataloggerBlock, (uint16_t)(REGISTER_IMAGE_SIZE - start));
+  uint16_t crc;
+
+  updateLiveValues();
+  foreignLength = 0;
+  foreign[foreignLength++] = slaveIds[0];
+  foreign[foreignLength++] = 0x04;
+  foreign[foreignLength++] = highByte(start);
+  foreign[foreignLength++] = lowByte(start);
+  foreign[foreignLength++] = highByte(count);
+  foreign[foreignLength++] = lowByte(count);
+  crc = crc16_update_block(0xFFFF, foreign, foreignLength);
+  foreign[foreignLength++] = lowByte(crc);
+  foreign[foreignLength++] = highByte(crc);
+  foreignRequestLength = foreignLength;
+
+  foreign[foreignLength++] = slaveIds[0];
+  foreign[foreignLength++] = 0x04;
+  foreign[foreignLength++] = count * 2;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    foreign[foreignLength++] = highByte(inputRegisters[start + i]);
+    foreign[foreignLength++] = lowByte(inputRegisters[start + i]);
+  }
+  crc = crc16_update_block(0xFFFF, foreign + foreignRequestLength, foreignLength - foreignRequestLength);
+  foreign[foreignLength++] = lowByte(crc);
+  foreign[foreignLength++] = highByte(crc);
+
+  foreignIndex = 0;
+  dataloggerStart = (start + count < REGISTER_IMAGE_SIZE) ? start + count : 0;
+  dataloggerNext += dataloggerPeriod;
+}
+
+// Bytes of the datalogger exchange that went over the wire by now
+uint16_t growattSimulator::foreignOnWire() {
+  uint32_t elapsed = micros() - foreignStart;
+  uint32_t bytes = elapsed / characterTime;
+
+  if (bytes > foreignRequestLength)
+  {
+    bytes = (elapsed < foreignRequestLength * (uint32_t)characterTime + turnaround) ? foreignRequestLength : (elapsed - turnaround) / characterTime;
+  }
+  return (bytes < foreignLength) ? bytes : foreignLength;
+}
+
+// true while the datalogger exchange is on the wire, including the turnaround
+bool growattSimulator::foreignTalking() {
+  return foreignLength && micros() - foreignStart < foreignLength * (uint32_t)characterTime + turnaround;
+}
+
+bool growattSimulator::answers(uint8_t slaveId) {
+  for (uint8_t i = 0; i < slaves; i++)
+  {
+    if (slaveIds[i] == slaveId)
+      return true;
+  }
+  return false;
+}
+
+void growattSimulator::appendCRC() {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < responseLength; i++)
+  {
+    crc = crc16_update(crc, response[i]);
+  }
+  response[responseLength++] = lowByte(crc);
+  response[responseLength++] = highByte(crc);
+}
+
+void growattSimulator::exceptionResponse(uint8_t function, uint8_t exception) {
+  responseLength = 0;
+  response[responseLength++] = request[0];
+  response[responseLength++] = function | 0x80;
+  response[responseLength++] = exception;
+  appendCRC();
+}
+
+void growattSimulator::processRequest() {
+  uint8_t function = request[1];
+  uint16_t address = (request[2] << 8) | request[3];
+  uint16_t quantity = (request[4] << 8) | request[5];
+  uint16_t crc = 0xFFFF;
+
+  for (uint16_t i = 0; i < requestLength - 2; i++)
+  {
+    crc = crc16_update(crc, request[i]);
+  }
+  // a real slave stays silent on a broken frame or a frame for another slave
+  if (lowByte(crc) != request[requestLength - 2] || highByte(crc) != request[requestLength - 1] || !answers(request[0]))
+  {
+    return;
+  }
+  requests++;
+  responseIndex = 0;
+  responseLength = 0;
+
+  switch (function)
+  {
+    case 0x03:
+    case 0x04:
+      if (quantity == 0 || quantity > 125 || address + quantity > REGISTER_IMAGE_SIZE)
+      {
+        exceptionResponse(function, 0x02);
+        return;
+      }
+      updateLiveValues();
+      response[responseLength++] = request[0];
+      response[responseLength++] = function;
+      response[responseLength++] = quantity * 2;
+      for (uint16_t i = 0; i < quantity; i++)
+      {
+        uint16_t value = (function == 0x03) ? holdingRegisters[address + i] : inputRegisters[address + i];
+        response[responseLength++] = highByte(value);
+        response[responseLength++] = lowByte(value);
+      }
+      break;
+
+    case 0x06:
+      if (address >= REGISTER_IMAGE_SIZE)
+      {
+        exceptionResponse(function, 0x02);
+        return;
+      }
+      holdingRegisters[address] = quantity;
+      memcpy(response, request, 6);                     // echo of the request
+      responseLength = 6;
+      break;
+
+    case 0x10:
+      if (quantity == 0 || address + quantity > REGISTER_IMAGE_SIZE)
+      {
+        exceptionResponse(function, 0x02);
+        return;
+      }
+      for (uint16_t i = 0; i < quantity; i++)
+      {
+        holdingRegisters[address + i] = (request[7 + 2 * i] << 8) | request[8 + 2 * i];
+      }
+      memcpy(response, request, 6);
+      responseLength = 6;
+      break;
+
+    default:
+      exceptionResponse(function, 0x01);
+      return;
+  }
+  appendCRC();
+}
+
+int growattSimulator::available() {
+  pollDatalogger();
+  if (foreignIndex < foreignLength)
+  {
+    return foreignOnWire() - foreignIndex;
+  }
+  return responseLength - responseIndex;
+}
+
+int growattSimulator::read() {
+  pollDatalogger();
+  if (foreignIndex < foreignLength)
+  {
+    return (foreignIndex < foreignOnWire()) ? foreign[foreignIndex++] : -1;
+  }
+  if (responseIndex >= responseLength)
+  {
+    return -1;
+  }
+  if (responseIndex + 1 == responseLength)
+  {
+    exchangeEnd = micros();
+  }
+  return response[responseIndex++];
+}
+
+int growattSimulator::peek() {
+  pollDatalogger();
+  if (foreignIndex < foreignLength)
+  {
+    return (foreignIndex < foreignOnWire()) ? foreign[foreignIndex] : -1;
+  }
+  if (responseIndex >= responseLength)
+  {
+    return -1;
+  }
+  return response[responseIndex];
+}
+
+void growattSimulator::flush() {
+}
+
+size_t growattSimulator::write(uint8_t data) {
+  uint16_t expected = 8;
+
+  if (requestLength >= maxFrameSize)
+  {
+    requestLength = 0;
+  }
+  pollDatalogger();
+  request[requestLength++] = data;
+  // both frames are garbled: the inverter does not answer, the datalogger gets a broken response
+  if (foreignTalking() && !collided)
+  {
+    collided = true;
+    collisions++;
+    foreign[foreignLength - 1] ^= 0x55;
+  }
+
+  // write multiple registers carries a byte count in front of the data
+  if (requestLength > 6 && request[1] == 0x10)
+  {
+    expected = 9 + request[6];
+  }
+  if (requestLength >= expected)
+  {
+    if (!collided)
+    {
+      processRequest();
+    }
+    requestLength = 0;
+    collided = false;
+    exchangeEnd = micros();
+  }
+  return 1;
+}
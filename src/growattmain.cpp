@@ -27,12 +27,18 @@
 #include <ESPAsyncWebServer.h>
 #endif
 #include <ESPConnect.h>
-#include <PubSubClient.h>     // MQTT support
 #include <WiFiUdp.h>
 #include <ArduinoOTA.h>
 #include "globals.h"
 #include "settings.h"
 #include "growattInterface.h"
+#include "mqttCommand.h"
+#include "asyncMqtt.h"          // MQTT support
+#include "offlineStore.h"
+#include <ArduinoJson.h>
+#ifdef SIMULATE_GROWATT
+#include "growattSimulator.h"
+#endif
 #include <EEPROM.h>
 
 #ifdef AHTXX_SENSOR
@@ -40,13 +46,22 @@
 #include <Wire.h>
 #endif
 
-#define MAX_JSON_TOPIC_LENGTH 1024
+#define MAX_JSON_TOPIC_LENGTH 448    // status message, the register messages are streamed, see publishJson()
+#define MQTT_BUFFER_SIZE 128         // incoming commands and short messages
+#define MQTT_OUTPUT_SIZE 2048        // outgoing queue, holds the messages of a loop() pass until flush()
 #define MAX_ROOT_TOPIC_LENGTH 80
-#define MAX_EXPECTED_TOPIC_LENGTH 50
+#define RECONNECT_MIN 1000           // ms before the second attempt to connect to the broker, doubled after each failure
+#define RECONNECT_MAX 60000          // ms, longest wait between two attempts
 
 bool updateRegister;
 bool updateStatus;
 bool checkWifi;
+#define ALL_INVERTERS ((1 << INVERTERS) - 1)
+volatile uint8_t publishSnapshot;                              // inverters whose next data message carries all fields, bit mask, set by timerCallback()
+uint8_t inputDue;                                              // inverters not yet read on this Modbus update, bit mask
+uint8_t nextInverter;                                          // round robin position, see HandleModbus()
+enum { jobNone, jobInput, jobHolding, jobWrite } modbusJob = jobNone;   // Modbus job in progress
+unsigned long loopTimeMax;                                     // longest loop() pass since the last status message [us]
 #ifdef AHTXX_SENSOR
 bool ath15_connected;
 #endif 
@@ -56,6 +71,29 @@ bool ath15_connected;
 char fullClientID[CLIENT_ID_SIZE];
 char topicRoot[TOPPIC_ROOT_SIZE]; // MQTT root topic for the device, + client ID
 
+// Topics of the device, built once by buildTopics() when topicRoot is known
+enum topicId : uint8_t { topicError, topicInfo, topicStatus, topicDiagnostics, topicConnection, topicWriteConfig, TOPICS };
+const char topicSuffixes[] = "error\0info\0status\0diagnostics\0connection\0writeconfig/#";
+// Topics of each inverter, below <topicRoot>/<slave ID> when there is more than one
+enum inverterTopicId : uint8_t { topicData, topicDataMsgPack, topicBacklog, topicSettings, topicInverterError,
+                                 topicStatistics, topicWrite, INVERTER_TOPICS };
+const char inverterTopicSuffixes[] = "data\0data/msgpack\0data/backlog\0settings\0error\0statistics\0write/#";
+#define INVERTER_ROOT_SIZE (TOPPIC_ROOT_SIZE + 4)              // + '/' and up to 3 digits of the slave ID
+char topicTable[TOPICS * TOPPIC_ROOT_SIZE + sizeof(topicSuffixes) +
+                INVERTERS * (INVERTER_TOPICS * INVERTER_ROOT_SIZE + sizeof(inverterTopicSuffixes))];   // root, '/' and suffix of each topic
+const char *topics[TOPICS];
+const char *inverterTopics[INVERTERS][INVERTER_TOPICS];
+
+unsigned long dispatchTimeMax;                                 // longest topic lookup in callback() since the last status message [us]
+// Broker connection, driven by reconnect()
+enum { mqttWaiting, mqttConnecting, mqttUp } mqttState = mqttWaiting;
+unsigned long reconnectAt;                                     // millis() of the next attempt
+unsigned long disconnectedSince;                               // millis() when the connection was lost
+uint8_t reconnectFailures;                                     // attempts failed in a row
+unsigned long reconnects;                                      // connects to the broker since boot
+unsigned long connectTime;                                     // ms from losing the connection until the last connect
+offlineStore backlog;                                          // data read while the broker could not be reached
+
 
 #ifndef ARDUINO_ESP32_DEV
   os_timer_t myTimer;
@@ -64,8 +102,7 @@ char topicRoot[TOPPIC_ROOT_SIZE]; // MQTT root topic for the device, + client ID
 #endif
 //ESP8266WebServer server(80);
 AsyncWebServer server(80);
-WiFiClient espClient;
-PubSubClient mqtt(mqtt_server, mqtt_server_port, espClient);
+asyncMqtt mqtt(mqtt_server, mqtt_server_port);
 
 #ifdef AHTXX_SENSOR
 AHT10 sensorAHT15(AHT10_ADDRESS_0X38);
@@ -73,6 +110,9 @@ AHT10 sensorAHT15(AHT10_ADDRESS_0X38);
 
 void callback(char *topic, byte *payload, unsigned int length);
 growattIF growattInterface(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+#ifdef SIMULATE_GROWATT
+growattSimulator simulatedInverter(slaveIds, INVERTERS);
+#endif
 
 
 
@@ -92,6 +132,9 @@ void IRAM_ATTR timerCallback()
 
   if (seconds % config.wificheck_sec == 0)
     checkWifi = true;
+
+  if (seconds % HEARTBEAT == 0)
+    publishSnapshot = ALL_INVERTERS;
 }
 #else
 void timerCallback(void *pArg)
@@ -107,76 +150,287 @@ void timerCallback(void *pArg)
 
   if (seconds % config.wificheck_sec == 0)
     checkWifi = true;
+
+  if (seconds % HEARTBEAT == 0)
+    publishSnapshot = ALL_INVERTERS;
 }
 #endif
 
 
-void ReadInputRegisters()
+// Streams a message of the inverter to the broker without holding it in RAM: serialize() runs once to
+// count the length for beginPublish() and once more writing into the MQTT client, in chunks of JSON_CHUNK_SIZE
+bool publishJson(const char *topic, uint8_t inverter, void (*serialize)(uint8_t inverter, jsonWriter &writer))
 {
-  char json[MAX_JSON_TOPIC_LENGTH];
-  char topic[MAX_ROOT_TOPIC_LENGTH];
-  uint8_t result;
+  jsonWriter counter;
+  serialize(inverter, counter);
+  if (!mqtt.beginPublish(topic, counter.length(), false))
+    return false;
+#ifdef DEBUG_MQTT
+  jsonWriter writer(mqtt, &SerialDebug);
+#else
+  jsonWriter writer(mqtt);
+#endif
+  serialize(inverter, writer);
+  writer.flush();
+#ifdef DEBUG_MQTT
+  SerialDebug.println();
+#endif
+  return mqtt.endPublish() && !writer.overflow();
+}
+
+// Sends a message that may be larger than the MQTT client buffer
+bool publishText(const char *topic, const char *text)
+{
+  size_t length = strlen(text);
+
+  if (!mqtt.beginPublish(topic, length, false))
+    return false;
+  return mqtt.write((const uint8_t *)text, length) == length && mqtt.endPublish();
+}
+
+#ifdef PUBLISH_MSGPACK
+// The selected input registers as MessagePack, the binary twin of the data message
+#define MSGPACK_DOCUMENT_SIZE JSON_OBJECT_SIZE(INPUT_REGISTER_COUNT)
+bool publishMsgPack(const char *topic, uint8_t inverter)
+{
+  StaticJsonDocument<MSGPACK_DOCUMENT_SIZE> doc;
+
+  growattInterface.InputRegistersToDocument(inverter, doc.to<JsonObject>());
+  if (!mqtt.beginPublish(topic, measureMsgPack(doc), false))
+    return false;
+  serializeMsgPack(doc, mqtt);
+  return mqtt.endPublish();
+}
+#endif
+
+// Keeps all input registers of the inverter for DrainBacklog(), stamped with the time they were read
+void StoreInputRegisters(uint8_t inverter)
+{
+  storedSnapshot record;
+
+  record.time = seconds;
+  record.inverter = inverter;
+  growattInterface.InputSnapshot(inverter, record.words);
+  backlog.push(record);
+}
+
+// {"age":<s since the registers were read>,"data":{<input registers>}}
+void writeStored(const storedSnapshot &record, uint32_t age, jsonWriter &writer)
+{
+  writer.append("{\"age\":");
+  writer.appendUnsigned(age);
+  writer.append(",\"data\":");
+  growattIF::InputSnapshotToJson(record.words, writer);
+  writer.append('}');
+}
+
+// Streams a stored snapshot like publishJson()
+bool publishStored(const storedSnapshot &record)
+{
+  uint32_t age = seconds - record.time;
+  jsonWriter counter;
+
+  writeStored(record, age, counter);
+  // QoS 1, the snapshot stays in the backlog until its PUBACK and is published again after a reconnect
+  if (!mqtt.beginPublish(inverterTopics[record.inverter][topicBacklog], counter.length(), false, 1))
+    return false;
+  jsonWriter writer(mqtt);
+  writeStored(record, age, writer);
+  writer.flush();
+  return mqtt.endPublish() && !writer.overflow();
+}
 
-  digitalWrite(STATUS_LED, 0);
-  result = growattInterface.ReadInputRegisters();
+// Publishes the data stored during an outage, oldest first, at the pace of offlineStore::drain(), and removes
+// the snapshots the broker acknowledged
+void DrainBacklog()
+{
+  backlog.acknowledge(mqtt.acknowledged());
+  if (mqtt.connected())
+  {
+    backlog.drain(publishStored);
+  }
+}
+
+// Publish the result of an input register read of the inverter
+void PublishInputRegisters(uint8_t inverter, uint8_t result)
+{
   if (result == growattInterface.Success)
   {
-    growattInterface.InputRegistersToJson(json);
-#ifdef DEBUG_MQTT
-    Serial.println(json);
+    // the broker can not be reached: the data is published later on data/backlog
+    if (strlen(mqtt_server) > 0 && !mqtt.connected())
+    {
+      StoreInputRegisters(inverter);
+      return;
+    }
+#ifdef PUBLISH_CHANGES
+    // only the fields that left their deadband, a full snapshot on the heartbeat and after a reconnect
+    // test and clear in one step, the timer may set the mask in between
+    noInterrupts();
+    bool snapshot = publishSnapshot & (1 << inverter);
+    publishSnapshot &= ~(1 << inverter);
+    interrupts();
+    if (snapshot)
+    {
+      growattInterface.SelectInputSnapshot(inverter);
+    }
+    else if (growattInterface.SelectInputChanges(inverter) == 0)
+    {
+      return;
+    }
+#else
+    growattInterface.SelectInputSnapshot(inverter);
+#endif
+    if (!publishJson(inverterTopics[inverter][topicData], inverter,
+                     [](uint8_t inverter, jsonWriter &writer) { growattInterface.InputRegistersToJson(inverter, writer); }))
+    {
+      StoreInputRegisters(inverter);
+      return;
+    }
+#ifdef PUBLISH_MSGPACK
+    publishMsgPack(inverterTopics[inverter][topicDataMsgPack], inverter);
 #endif
-    snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/data", topicRoot);
-    mqtt.publish(topic, json);
 #ifdef DEBUG_MQTT
-    Serial.println("Data MQTT sent");
+    SerialDebug.println("Data MQTT sent");
 #endif    
   }
   else 
   {
-    Serial.print(F("Error: "));
+    SerialDebug.print(F("Error: "));
     String message = growattInterface.sendModbusError(result);
-    Serial.println(message);
-    snprintf(topic, MAX_ROOT_TOPIC_LENGTH , "%s/error", topicRoot);
-    mqtt.publish(topic, message.c_str());
-    delay(5);
+    SerialDebug.println(message);
+    mqtt.publish(inverterTopics[inverter][topicInverterError], message.c_str());
   }
-  digitalWrite(STATUS_LED, 1);
 }
 
-void ReadHoldingRegisters()
+// Publish the result of a holding register read of the inverter
+void PublishHoldingRegisters(uint8_t inverter, uint8_t result)
 {
-  char json[MAX_JSON_TOPIC_LENGTH];
-  char topic[MAX_ROOT_TOPIC_LENGTH];
-
-  uint8_t result;
-
-  digitalWrite(STATUS_LED, 0);
-  result = growattInterface.ReadHoldingRegisters();
   if (result == growattInterface.Success)
   {
-    growattInterface.HoldingRegistersToJson(json);
+    publishJson(inverterTopics[inverter][topicSettings], inverter,
+                [](uint8_t inverter, jsonWriter &writer) { growattInterface.HoldingRegistersToJson(inverter, writer); });
 #ifdef DEBUG_MQTT
-    Serial.println(json);
-#endif
-    snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/settings", topicRoot);
-    mqtt.publish(topic, json);
-#ifdef DEBUG_MQTT
-    Serial.println("Setting MQTT sent");
+    SerialDebug.println("Setting MQTT sent");
 #endif    
-    // Set the flag to true not to read the holding registers again
-    holdingregisters = false;
+    // Clear the flag not to read the holding registers again
+    holdingregisters &= ~(1 << inverter);
   }
   else
   {
-    Serial.print(F("Error: "));
+    SerialDebug.print(F("Error: "));
     String message;
     message = growattInterface.sendModbusError(result);
-    Serial.println(message);
-    snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-    mqtt.publish(topic, message.c_str());
-    delay(5);
+    SerialDebug.println(message);
+    mqtt.publish(inverterTopics[inverter][topicInverterError], message.c_str());
   }
-  digitalWrite(STATUS_LED, 1);
+}
+
+// Result of a queued register write of the inverter, its settings are read again after a change
+void PublishWriteResult(uint8_t inverter, uint8_t result)
+{
+  char message[MAX_ROOT_TOPIC_LENGTH];
+
+  if (result == growattInterface.Success)
+  {
+    holdingregisters |= 1 << inverter;
+  }
+  else
+  {
+    snprintf(message, MAX_ROOT_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
+    mqtt.publish(inverterTopics[inverter][topicInverterError], message);
+  }
+}
+
+// Runs the Modbus jobs in the background of loop(): queued register writes first, then the reads of
+// the inverters due on this update, one job per inverter in turn. The jobs follow each other with
+// only the request gap, one transaction at a time. An inverter left over when the next update starts
+// is not read twice, and the turn carries on behind the last one read, so none is starved.
+void HandleModbus()
+{
+  uint8_t inverter;
+
+#ifdef MODBUS_LISTEN_ONLY
+  // nothing is sent: each update publishes the inverters whose registers came with the responses to the
+  // other master since the last one
+  growattInterface.poll();
+  if (updateRegister == true)
+  {
+    uint8_t input = growattInterface.heard(false);
+    uint8_t holding = growattInterface.heard(true);
+
+    for (inverter = 0; inverter < INVERTERS; inverter++)
+    {
+      if (input & (1 << inverter))
+        PublishInputRegisters(inverter, growattInterface.Success);
+      if (holding & (1 << inverter))
+        PublishHoldingRegisters(inverter, growattInterface.Success);
+    }
+    updateRegister = false;
+  }
+  return;
+#endif
+
+  if (updateRegister == true)
+  {
+#ifdef STATUS_LED
+    digitalWrite(STATUS_LED, 0);
+#endif
+    inputDue = ALL_INVERTERS;
+    updateRegister = false;
+  }
+
+  if (modbusJob == jobNone && growattInterface.writesQueued() > 0)
+  {
+    growattInterface.beginWrite();
+    modbusJob = jobWrite;
+  }
+  else if (modbusJob == jobNone && inputDue != 0)
+  {
+    while (!(inputDue & (1 << nextInverter)))
+    {
+      nextInverter = (nextInverter + 1) % INVERTERS;
+    }
+    growattInterface.beginReadInputRegisters(nextInverter);
+    inputDue &= ~(1 << nextInverter);
+    nextInverter = (nextInverter + 1) % INVERTERS;
+    modbusJob = jobInput;
+  }
+
+  growattInterface.poll();
+  if (modbusJob == jobNone || !growattInterface.done())
+  {
+    return;
+  }
+
+  inverter = growattInterface.inverter();
+  if (modbusJob == jobWrite)
+  {
+    PublishWriteResult(inverter, growattInterface.result());
+    modbusJob = jobNone;
+    return;
+  }
+  if (modbusJob == jobInput)
+  {
+    PublishInputRegisters(inverter, growattInterface.result());
+    if (holdingregisters & (1 << inverter))
+    {
+      // Read the holding registers
+      growattInterface.beginReadHoldingRegisters(inverter);  //Settings
+      modbusJob = jobHolding;
+      return;
+    }
+  }
+  else
+  {
+    PublishHoldingRegisters(inverter, growattInterface.result());
+  }
+  modbusJob = jobNone;
+#ifdef STATUS_LED
+  if (inputDue == 0)
+  {
+    digitalWrite(STATUS_LED, 1);
+  }
+#endif
 }
 
 
@@ -207,259 +461,335 @@ void loadEEpromData()
     #else
      nvs_flash_erase();
     nvs_flash_init();
-    Serial.println("NVS partition erased.");
+    SerialDebug.println("NVS partition erased.");
 
     #endif
 
 #ifdef DEBUG_SERIAL
     delay(3000);
-    Serial.println(F("Reset eesprom values to default and clean Wifi settings"));
+    SerialDebug.println(F("Reset eesprom values to default and clean Wifi settings"));
     
 #endif
   }
 }
 
-// MQTT reconnect logic
-void reconnect()
+// Schedules the next attempt to connect to the broker: RECONNECT_MIN doubled with each failure up to RECONNECT_MAX,
+// of which the upper half is random, so gateways that lost the broker together do not return in lockstep
+void backoff()
 {
-  // String mytopic;
-  //  Loop until we're reconnected
-  char topic[MAX_ROOT_TOPIC_LENGTH];
-
-  while (!mqtt.connected())
-  {
-    Serial.print("Attempting MQTT connection...");
-    Serial.print(F("Client ID: "));
-    Serial.println(fullClientID);
-    // Attempt to connect
-    snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/%s", topicRoot, "connection");
-    if (mqtt.connect(fullClientID, mqtt_user, mqtt_password, topic, 1, true, "offline"))
-    { // last will
-      Serial.println(F("connected"));
-      // ... and resubscribe
-      mqtt.publish(topic, "online", true);
-      snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/write/#", topicRoot);
-      mqtt.subscribe(topic);
-      snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/writeconfig/#", topicRoot);
-      mqtt.subscribe(topic);
-    }
-    else
-    {
-      Serial.print(F("failed, rc="));
-      Serial.print(mqtt.state());
-      Serial.println(F(" try again in 5 seconds"));
-      // Wait 5 seconds before retrying
-      delay(5000);
-    }
+  unsigned long wait = RECONNECT_MAX;
+
+  if (reconnectFailures < 16 && ((unsigned long)RECONNECT_MIN << reconnectFailures) < RECONNECT_MAX)
+  {
+    wait = (unsigned long)RECONNECT_MIN << reconnectFailures;
   }
+  if (reconnectFailures < UINT8_MAX)
+  {
+    reconnectFailures++;
+  }
+  reconnectAt = millis() + wait / 2 + random(wait / 2 + 1);
 }
 
-// MQTT receive messages
-void callback(char *topic, byte *payload, unsigned int length)
+// Subscribes to the commands once the broker accepted the login
+void brokerConnected()
 {
-  // Convert the incoming byte array to a string
-
-  unsigned int i = 0;
-  uint8_t result;
-  uint16_t resparam;
-  char json[MAX_JSON_TOPIC_LENGTH];
-  char rootTopic[MAX_ROOT_TOPIC_LENGTH];
-  char expectedTopic[MAX_EXPECTED_TOPIC_LENGTH];
-  char payloadString[30];
-  
-  for (i = 0; i < length; i++)
-  { // each char to upper
-    payloadString[i] = toupper(payload[i]);
-  }
-  payloadString[length] = '\0'; // Null terminator used to terminate the char array
-  String message = (char *)payloadString;
-
-#ifdef DEBUG_SERIAL
-  Serial.print(F("Message arrived on topic: ["));
-  Serial.print(topic);
-  Serial.print(F("], "));
-  Serial.println(message);
-#endif
-
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH, "%s/write/getSettings", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+  SerialDebug.println(F("connected"));
+  backlog.resend();                               // a clean session, the snapshots without PUBACK go out again
+  // ... and resubscribe
+  mqtt.publish(topics[topicConnection], "online", true);
+  publishSnapshot = ALL_INVERTERS;
+  for (uint8_t i = 0; i < INVERTERS; i++)
   {
-    if (message == "ON")
-    {
-      holdingregisters = true;
-    }
+    mqtt.subscribe(inverterTopics[i][topicWrite]);
   }
+  mqtt.subscribe(topics[topicWriteConfig]);
+}
 
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH , "%s/write/setEnable", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+// MQTT reconnect logic, called by loop() while the client is not connected. The client connects on the async
+// TCP stack, so a broker or WiFi that is down costs no time in loop(): the inverters are still read and their
+// data is stored. mqtt.loop() gives up on a login without CONNACK after MQTT_CONNECT_TIMEOUT.
+void reconnect()
+{
+  switch (mqttState)
   {
-    if (message == "ON")
-    {
-      result = growattInterface.writeRegister(growattInterface.regOnOff, 1);
-      if (result == growattInterface.Success)
-      {
-        holdingregisters = true;
+    case mqttUp:
+      SerialDebug.println(F("MQTT connection lost"));
+      disconnectedSince = millis();
+      reconnectAt = millis();
+      mqttState = mqttWaiting;
+      break;
+
+    case mqttWaiting:
+      if ((long)(millis() - reconnectAt) < 0)
+        break;
+      SerialDebug.print("Attempting MQTT connection...");
+      SerialDebug.print(F("Client ID: "));
+      SerialDebug.println(fullClientID);
+      if (!mqtt.connect(fullClientID, mqtt_user, mqtt_password, topics[topicConnection], 1, true, "offline"))
+      { // last will
+        backoff();
+        break;
       }
-      else
+      mqttState = mqttConnecting;
+      break;
+
+    case mqttConnecting:
+      if (mqtt.state() == asyncMqtt::stateConnecting)
+        break;
+      if (!mqtt.connected())
       {
-        snprintf(json, MAX_JSON_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
-        snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-        mqtt.publish(rootTopic, json);
+        SerialDebug.print(F("failed, rc="));
+        SerialDebug.println(mqtt.state());
+        mqttState = mqttWaiting;
+        backoff();
+        break;
       }
-    }
-    else if (message == "OFF")
-    {
-        result = growattInterface.writeRegister(growattInterface.regOnOff, 0);
-        if (result == growattInterface.Success)
-        {
-          holdingregisters = true;
-        }
-        {
-          snprintf(json, MAX_JSON_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
-          snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-          mqtt.publish(rootTopic, json);
-        }
-     } 
-  }
-
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH , "%s/write/setMaxOutput", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
-  {
-    result = growattInterface.writeRegister(growattInterface.regMaxOutputActive, message.toInt());
-    if (result == growattInterface.Success)
-    {
-      holdingregisters = true;
-    }
+      brokerConnected();
+      reconnects++;
+      connectTime = millis() - disconnectedSince;
+      reconnectFailures = 0;
+      mqttState = mqttUp;
+      break;
+  }
+}
+
+// Builds the topics of the device and of each inverter in topicTable
+void buildTopics()
+{
+  char *next = topicTable;
+  const char *suffix = topicSuffixes;
+  char inverterRoot[INVERTER_ROOT_SIZE];
+
+  for (uint8_t t = 0; t < TOPICS; t++)
+  {
+    topics[t] = next;
+    next += sprintf(next, "%s/%s", topicRoot, suffix) + 1;
+    suffix += strlen(suffix) + 1;
+  }
+  for (uint8_t i = 0; i < INVERTERS; i++)
+  {
+    if (INVERTERS == 1)
+      strcpy(inverterRoot, topicRoot);
     else
+      sprintf(inverterRoot, "%s/%u", topicRoot, slaveIds[i]);
+    suffix = inverterTopicSuffixes;
+    for (uint8_t t = 0; t < INVERTER_TOPICS; t++)
     {
-      snprintf(json, MAX_JSON_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
-      snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-      mqtt.publish(rootTopic, json);
+      inverterTopics[i][t] = next;
+      next += sprintf(next, "%s/%s", inverterRoot, suffix) + 1;
+      suffix += strlen(suffix) + 1;
     }
   }
+}
 
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH , "%s/write/setStartVoltage", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+// Inverter addressed by the "<slave ID>/" in front of a command suffix, the suffix is moved behind it.
+// The commands of the device and of a single inverter carry no slave ID, they get the first inverter.
+// INVERTERS when the slave ID is not on the bus.
+uint8_t findInverter(const char **suffix)
+{
+  char *end;
+  unsigned long id = strtoul(*suffix, &end, 10);
+
+  if (end == *suffix || *end != '/')
+    return 0;
+  for (uint8_t i = 0; i < INVERTERS; i++)
   {
-    result = growattInterface.writeRegister(growattInterface.regStartVoltage, (message.toInt() * 10)); //*10 transmit with one digit after decimal place
-    if (result == growattInterface.Success)
-    {
-      holdingregisters = true;
-    }
-    else
+    if (slaveIds[i] == id)
     {
-      snprintf(json, MAX_JSON_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
-      snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-      mqtt.publish(rootTopic, json);
+      *suffix = end + 1;
+      return i;
     }
   }
+  return INVERTERS;
+}
+
+// Commands that are more than a holding register write, see commands[]
+uint8_t getSettings(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  if (value)
+  {
+    holdingregisters |= 1 << inverter;
+  }
+  return growattIF::Success;
+}
 
 #ifdef useModulPower
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH , "%s/write/setModulPower", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+// The inverter is switched off while the power stage is changed, the bus stays silent after each step
+uint8_t setModulPower(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  if (WRITE_QUEUE_SIZE - growattInterface.writesQueued() < 3)
   {
-    growattInterface.writeRegister(growattInterface.regOnOff, 0);
-    delay(500);
+    return growattIF::QueueFull;
+  }
+  growattInterface.queueWrite(inverter, growattInterface.regOnOff, 0, 500);
+  growattInterface.queueWrite(inverter, growattInterface.regModulPower, value, 500);
+  growattInterface.queueWrite(inverter, growattInterface.regOnOff, 1, 1500);
+  return growattIF::Success;
+}
+#endif
 
-    result = growattInterface.writeRegister(growattInterface.regModulPower, int(strtol(message.c_str(), NULL, 16)));
-    delay(500);
+// Writes contiguous holding registers in one transaction, payload {"register":52,"values":[1840,2640]}
+// The payload is read only, so the document also holds copies of the two keys
+#define SET_REGISTERS_DOCUMENT_SIZE (JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(WRITE_BLOCK_SIZE) + \
+                                     JSON_STRING_SIZE(sizeof("register") - 1) + JSON_STRING_SIZE(sizeof("values") - 1))
+uint8_t setRegisters(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  StaticJsonDocument<SET_REGISTERS_DOCUMENT_SIZE> doc;
+  uint16_t values[WRITE_BLOCK_SIZE];
+  uint8_t count = 0;
 
-    growattInterface.writeRegister(growattInterface.regOnOff, 1);
-    delay(1500);
-    
-    if (result == growattInterface.Success)
-    {
-      holdingregisters = true;
-    }
-    else
+  if (deserializeJson(doc, (const char *)payload, length) || !doc["register"].is<uint16_t>())
+  {
+    return ModbusMaster::ku8MBIllegalDataValue;
+  }
+  for (JsonVariant v : doc["values"].as<JsonArray>())
+  {
+    if (count == WRITE_BLOCK_SIZE || !v.is<uint16_t>())
     {
-      snprintf(json, MAX_JSON_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
-      snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/error", topicRoot);
-      mqtt.publish(rootTopic, json);
+      return ModbusMaster::ku8MBIllegalDataValue;
     }
+    values[count++] = v.as<uint16_t>();
   }
-#endif
+  return growattInterface.queueWrite(inverter, doc["register"].as<uint16_t>(), values, count);
+}
+
+// Stores a period of the configuration and confirms it on the info topic
+uint8_t updatePeriod(uint16 *period, int32_t value, const char *format)
+{
+  char info[MAX_ROOT_TOPIC_LENGTH];
 
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH, "%s/writeconfig/setModbusUpd", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+  if (*period != value)
   {
-    resparam = message.toInt();
-    if (resparam != config.modbus_update_sec)
-    {
-      if (resparam > 0)
-      {
-       config.modbus_update_sec = resparam;
-       saveConfig();
-      } 
-    }
-    snprintf(json, MAX_JSON_TOPIC_LENGTH, "Reading Modbus values updated to %d sec", config.modbus_update_sec);
-    snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/info", topicRoot);
-    mqtt.publish(rootTopic, json);
-#ifdef DEBUG_SERIAL
-    Serial.println(json);
-#endif    
+    *period = value;
+    saveConfig();
   }
+  snprintf(info, MAX_ROOT_TOPIC_LENGTH, format, *period);
+  mqtt.publish(topics[topicInfo], info);
+#ifdef DEBUG_SERIAL
+  SerialDebug.println(info);
+#endif
+  return growattIF::Success;
+}
+
+uint8_t setModbusUpdate(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  return updatePeriod(&config.modbus_update_sec, value, "Reading Modbus values updated to %d sec");
+}
 
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH, "%s/writeconfig/setStatusUpd", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+uint8_t setStatusUpdate(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  return updatePeriod(&config.status_update_sec, value, "Send Status updated to %d sec");
+}
+
+uint8_t setWifiCheck(uint8_t inverter, int32_t value, const uint8_t *payload, unsigned int length)
+{
+  return updatePeriod(&config.wificheck_sec, value, "Check Wifi Status updated to %d sec");
+}
+
+// Incoming commands, sorted by suffix for findCommand(). A holding register write is one more row
+// with handler NULL; it is queued and the settings are read again after it succeeded.
+// With more than one inverter the write/ commands are received below <topicRoot>/<slave ID>.
+const mqttCommand commands[] = {
+  // suffix                       argument    minimum maximum register                         handler
+  { "write/getSettings",          argOnOff,   0,      1,      0,                               getSettings },
+  { "write/setEnable",            argOnOff,   0,      1,      growattIF::regOnOff,             NULL },
+  { "write/setMaxOutput",         argInteger, 0,      255,    growattIF::regMaxOutputActive,   NULL },
+#ifdef useModulPower
+  { "write/setModulPower",        argHex,     0,      0xffff, growattIF::regModulPower,        setModulPower },
+#endif
+  { "write/setRegisters",         argPayload, 1,      256,    0,                               setRegisters },
+  { "write/setStartVoltage",      argTenths,  0,      10000,  growattIF::regStartVoltage,      NULL },
+  { "writeconfig/setModbusUpd",   argInteger, 1,      65535,  0,                               setModbusUpdate },
+  { "writeconfig/setStatusUpd",   argInteger, 1,      65535,  0,                               setStatusUpdate },
+  { "writeconfig/setWifiCheck",   argInteger, 1,      65535,  0,                               setWifiCheck }
+};
+#define COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+// MQTT receive messages
+void callback(char *topic, byte *payload, unsigned int length)
+{
+  char message[MAX_ROOT_TOPIC_LENGTH];
+  size_t rootLength = strlen(topicRoot);
+  const mqttCommand *command = NULL;
+  const char *suffix;
+  const char *errorTopic = topics[topicError];
+  unsigned long dispatchStart = micros();
+  uint8_t inverter = 0;
+  int32_t value;
+  uint8_t result;
+
+  if (strncmp(topic, topicRoot, rootLength) == 0 && topic[rootLength] == '/')
   {
-    resparam = message.toInt();
-    if (resparam != config.status_update_sec)
+    suffix = topic + rootLength + 1;
+    inverter = findInverter(&suffix);
+    if (inverter < INVERTERS)
     {
-      if (resparam > 0)
-      {
-       config.status_update_sec = resparam;
-       saveConfig();
-      }
+      command = findCommand(commands, COMMANDS, suffix);
+      if (suffix != topic + rootLength + 1)
+        errorTopic = inverterTopics[inverter][topicInverterError];
     }
-    snprintf(json, MAX_JSON_TOPIC_LENGTH, "Send Status updated to %d sec", config.status_update_sec);
-    snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/info", topicRoot);
-    mqtt.publish(rootTopic, json);
+  }
+  if (micros() - dispatchStart > dispatchTimeMax)
+  {
+    dispatchTimeMax = micros() - dispatchStart;
+  }
+
 #ifdef DEBUG_SERIAL
-    Serial.println(json);
-#endif    
+  SerialDebug.print(F("Message arrived on topic: ["));
+  SerialDebug.print(topic);
+  SerialDebug.print(F("], "));
+  SerialDebug.write(payload, length);
+  SerialDebug.println();
+#endif
+
+  if (command == NULL)
+    return;
+
+  if (!parseArgument(command->argument, payload, length, &value) || value < command->minimum || value > command->maximum)
+  {
+    snprintf(message, MAX_ROOT_TOPIC_LENGTH, "invalid value for %s", command->suffix);
+    mqtt.publish(errorTopic, message);
+    return;
   }
 
-  snprintf(expectedTopic, MAX_EXPECTED_TOPIC_LENGTH, "%s/writeconfig/setWifiCheck", topicRoot);
-  if (strcmp(expectedTopic, topic) == 0)
+  if (command->handler)
   {
-    resparam = message.toInt();
-    if (resparam != config.wificheck_sec)
-    {
-      if (resparam > 0)
-      {
-       config.wificheck_sec = resparam;
-       saveConfig();
-      }
-    }
-    snprintf(json, MAX_JSON_TOPIC_LENGTH, "Check Wifi Status updated to %d sec", config.wificheck_sec);
-    snprintf(rootTopic, MAX_ROOT_TOPIC_LENGTH, "%s/info", topicRoot);
-    mqtt.publish(rootTopic, json);
-#ifdef DEBUG_SERIAL
-    Serial.println(json);
-#endif    
+    result = command->handler(inverter, value, payload, length);
+  }
+  else
+  {
+    result = growattInterface.queueWrite(inverter, command->reg, value);
+  }
+  if (result != growattInterface.Success)
+  {
+    snprintf(message, MAX_ROOT_TOPIC_LENGTH, "last trasmition has faild with: %s", growattInterface.sendModbusError(result).c_str());
+    mqtt.publish(errorTopic, message);
   }
 }
 
 void setup()
 {
-  Serial.begin(SERIAL_RATE);
-  Serial.println(F("\nGrowatt Solar Inverter to MQTT Gateway"));
+  SerialDebug.begin(SERIAL_RATE);
+  SerialDebug.println(F("\nGrowatt Solar Inverter to MQTT Gateway"));
   // Init outputs, RS485 in receive mode
+#ifdef STATUS_LED
   pinMode(STATUS_LED, OUTPUT);
+#endif
 
   // Initialize some variables
   uptime = 0;
   updateRegister = true;
   updateStatus = true;
   checkWifi = true;
+  publishSnapshot = ALL_INVERTERS;
+  disconnectedSince = millis();
 
   loadEEpromData();
 #ifdef DEBUG_SERIAL
-  Serial.println(F("Load Update values"));
-  Serial.printf("Values via Modbus: %d sec\n", config.modbus_update_sec);
-  Serial.printf("Status Update: %d sec\n", config.status_update_sec);
-  Serial.printf("Wifi Check: %d sec\n", config.wificheck_sec);
+  SerialDebug.println(F("Load Update values"));
+  SerialDebug.printf("Values via Modbus: %d sec\n", config.modbus_update_sec);
+  SerialDebug.printf("Status Update: %d sec\n", config.status_update_sec);
+  SerialDebug.printf("Wifi Check: %d sec\n", config.wificheck_sec);
 #endif
 
   // Connect to Wifi
@@ -467,7 +797,7 @@ void setup()
   // Configures static IP address
   if (!WiFi.config(local_IP, gateway, subnet, primaryDNS, secondaryDNS))
   {
-    Serial.println("STA Failed to configure");
+    SerialDebug.println("STA Failed to configure");
   }
 #endif
   //  AutoConnect AP - Configure SSID and password for Captive Portal
@@ -476,15 +806,15 @@ void setup()
 // Begin connecting to previous WiFi or start autoConnect AP if unable to connect
   if (ESPConnect.begin(&server))
   {
-    Serial.println("");
-    Serial.println("Connected to WiFi");
-    Serial.println("IPAddress: " + WiFi.localIP().toString());
-    Serial.print("Signal [RSSI]: ");
-    Serial.println(WiFi.RSSI());
+    SerialDebug.println("");
+    SerialDebug.println("Connected to WiFi");
+    SerialDebug.println("IPAddress: " + WiFi.localIP().toString());
+    SerialDebug.print("Signal [RSSI]: ");
+    SerialDebug.println(WiFi.RSSI());
   }
   else
   {
-    Serial.println("Failed to connect to WiFi");
+    SerialDebug.println("Failed to connect to WiFi");
     ESP.restart();
   }
   // Set up the fully client ID
@@ -492,20 +822,37 @@ void setup()
   WiFi.macAddress(mac);
   snprintf(fullClientID, CLIENT_ID_SIZE, "%s-%02x%02x%02x", clientID, mac[3], mac[4], mac[5]);
   snprintf(topicRoot, TOPPIC_ROOT_SIZE, "%s-%02x%02x%02x", clientID, mac[3], mac[4], mac[5]);
+  buildTopics();
 
-  Serial.print(F("Client ID: "));
-  Serial.println(fullClientID);
+  SerialDebug.print(F("Client ID: "));
+  SerialDebug.println(fullClientID);
 
   // Set up the Modbus line
+#ifdef SIMULATE_GROWATT
+  growattInterface.initGrowatt(simulatedInverter);
+#ifdef MODBUS_SHARED_BUS
+  simulatedInverter.setDatalogger(2000);               // a datalogger reads the first inverter every 2 s
+#endif
+  SerialDebug.println("Modbus connection is simulated");
+#elif defined(MODBUS_HARDWARE_SERIAL)
+#ifdef ESP32
+  growattInterface.initGrowatt(Serial2);
+#else
+  growattInterface.initGrowatt(Serial);
+#endif
+  SerialDebug.println("Modbus connection is set up on the hardware UART");
+#else
   growattInterface.initGrowatt();
-  Serial.println("Modbus connection is set up");
+  SerialDebug.println("Modbus connection is set up");
+#endif
+  backlog.begin();
 
   #ifdef AHTXX_SENSOR
     // AHT15 connection check
     ath15_connected = sensorAHT15.begin(SDA_PIN, SCL_PIN);
     if (ath15_connected != true)
     {
-      Serial.println(F("AHT15 sensor not connected or fail to load calibration coefficient"));
+      SerialDebug.println(F("AHT15 sensor not connected or fail to load calibration coefficient"));
     }
   #endif
 
@@ -524,13 +871,14 @@ void setup()
               { request->send(200, "text/plain", "Growatt Solar Inverter to MQTT Gateway"); });
 
     server.begin();
-    Serial.println(F("HTTP server started"));
+    SerialDebug.println(F("HTTP server started"));
 
     // Set up the MQTT server connection
     if (strlen(mqtt_server) > 0)
     {
       mqtt.setServer(mqtt_server, mqtt_server_port);
-      mqtt.setBufferSize(1024);
+      mqtt.setBufferSize(MQTT_BUFFER_SIZE);
+      mqtt.setOutputBufferSize(MQTT_OUTPUT_SIZE);
       mqtt.setCallback(callback);
     }
 
@@ -551,11 +899,11 @@ void setup()
   #else
       timerAlarmDisable(myTimer);
   #endif
-     Serial.println("Start"); });
+     SerialDebug.println("Start"); });
 
     ArduinoOTA.onEnd([]()
                      {
-      Serial.println("\nEnd");
+      SerialDebug.println("\nEnd");
     
       #ifndef ESP32
       os_timer_arm(&myTimer, 1000, true); 
@@ -567,16 +915,16 @@ void setup()
     });
 
     ArduinoOTA.onProgress([](unsigned int progress, unsigned int total)
-                          { Serial.printf("Progress: %u%%\r", (progress / (total / 100))); });
+                          { SerialDebug.printf("Progress: %u%%\r", (progress / (total / 100))); });
 
     ArduinoOTA.onError([](ota_error_t error)
                        {
-      Serial.printf("Error[%u]: ", error);
-      if (error == OTA_AUTH_ERROR) Serial.println("Auth Failed");
-      else if (error == OTA_BEGIN_ERROR) Serial.println("Begin Failed");
-      else if (error == OTA_CONNECT_ERROR) Serial.println("Connect Failed");
-      else if (error == OTA_RECEIVE_ERROR) Serial.println("Receive Failed");
-      else if (error == OTA_END_ERROR) Serial.println("End Failed"); });
+      SerialDebug.printf("Error[%u]: ", error);
+      if (error == OTA_AUTH_ERROR) SerialDebug.println("Auth Failed");
+      else if (error == OTA_BEGIN_ERROR) SerialDebug.println("Begin Failed");
+      else if (error == OTA_CONNECT_ERROR) SerialDebug.println("Connect Failed");
+      else if (error == OTA_RECEIVE_ERROR) SerialDebug.println("Receive Failed");
+      else if (error == OTA_END_ERROR) SerialDebug.println("End Failed"); });
 
     ArduinoOTA.begin();
 }
@@ -584,12 +932,13 @@ void setup()
 void loop()
 {
   char value[MAX_JSON_TOPIC_LENGTH];
-  char topic[MAX_ROOT_TOPIC_LENGTH];
 #ifdef AHTXX_SENSOR
   float valueTemp;
   float valueHum;
 #endif
 
+  unsigned long loopStart = micros();
+
   ArduinoOTA.handle();
 
   // Handle HTTP server requests
@@ -606,16 +955,8 @@ void loop()
   }
 
   // Query the modbus device
-  if (updateRegister == true)
-  {
-    ReadInputRegisters();
-    if (holdingregisters == true)
-    {
-      // Read the holding registers
-      ReadHoldingRegisters();  //Settings
-    }
-    updateRegister = false;
-  }
+  HandleModbus();
+  DrainBacklog();
 
   // Send RSSI and uptime status
   if (updateStatus == true)
@@ -639,17 +980,27 @@ void loop()
         valueHum = 0;
       }
 #ifdef DEBUG_SERIAL
-      Serial.printf("Temperature: %.2f °C      Humidity: %.2f %%\n", valueTemp, valueHum);
+      SerialDebug.printf("Temperature: %.2f °C      Humidity: %.2f %%\n", valueTemp, valueHum);
 #endif
-      snprintf(value, MAX_JSON_TOPIC_LENGTH, "{\"rssi\":%d,\"uptime\":%lu,\"ssid\":\"%s\",\"ip\":\"%d.%d.%d.%d\",\"clientid\":\"%s\",\"version\":\"%s\",\"modbusUpdate\":%d,\"statusUpdate\":%d,\"Wifi check\":%d,\"temperature\":%.2f,\"humidity\":%.2f}", WiFi.RSSI(), uptime, WiFi.SSID().c_str(), WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], WiFi.localIP()[3], fullClientID, buildversion, config.modbus_update_sec, config.status_update_sec, config.wificheck_sec, valueTemp, valueHum);
+      snprintf(value, MAX_JSON_TOPIC_LENGTH, "{\"rssi\":%d,\"uptime\":%lu,\"ssid\":\"%s\",\"ip\":\"%d.%d.%d.%d\",\"clientid\":\"%s\",\"version\":\"%s\",\"modbusUpdate\":%d,\"statusUpdate\":%d,\"Wifi check\":%d,\"maxLoopTime\":%lu,\"maxDispatchTime\":%lu,\"mqttBytes\":%lu,\"mqttSegments\":%lu,\"backlog\":%u,\"backlogDropped\":%lu,\"reconnects\":%lu,\"connectTime\":%lu,\"inflight\":%u,\"temperature\":%.2f,\"humidity\":%.2f}", WiFi.RSSI(), uptime, WiFi.SSID().c_str(), WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], WiFi.localIP()[3], fullClientID, buildversion, config.modbus_update_sec, config.status_update_sec, config.wificheck_sec, loopTimeMax, dispatchTimeMax, (unsigned long)mqtt.getSentBytes(), (unsigned long)mqtt.getSentSegments(), backlog.size(), (unsigned long)backlog.droppedSnapshots(), reconnects, connectTime, mqtt.inflightMessages(), valueTemp, valueHum);
 #else
-      snprintf(value, MAX_JSON_TOPIC_LENGTH, "{\"rssi\":%d,\"uptime\":%lu,\"ssid\":\"%s\",\"ip\":\"%d.%d.%d.%d\",\"clientid\":\"%s\",\"version\":\"%s\",\"modbusUpdate\":%d,\"statusUpdate\":%d,\"Wifi check\":%d}", WiFi.RSSI(), uptime, WiFi.SSID().c_str(), WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], WiFi.localIP()[3], fullClientID, buildversion, config.modbus_update_sec, config.status_update_sec, config.wificheck_sec);
+      snprintf(value, MAX_JSON_TOPIC_LENGTH, "{\"rssi\":%d,\"uptime\":%lu,\"ssid\":\"%s\",\"ip\":\"%d.%d.%d.%d\",\"clientid\":\"%s\",\"version\":\"%s\",\"modbusUpdate\":%d,\"statusUpdate\":%d,\"Wifi check\":%d,\"maxLoopTime\":%lu,\"maxDispatchTime\":%lu,\"mqttBytes\":%lu,\"mqttSegments\":%lu,\"backlog\":%u,\"backlogDropped\":%lu,\"reconnects\":%lu,\"connectTime\":%lu,\"inflight\":%u}", WiFi.RSSI(), uptime, WiFi.SSID().c_str(), WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], WiFi.localIP()[3], fullClientID, buildversion, config.modbus_update_sec, config.status_update_sec, config.wificheck_sec, loopTimeMax, dispatchTimeMax, (unsigned long)mqtt.getSentBytes(), (unsigned long)mqtt.getSentSegments(), backlog.size(), (unsigned long)backlog.droppedSnapshots(), reconnects, connectTime, mqtt.inflightMessages());
+#endif
+      publishText(topics[topicStatus], value);
+      loopTimeMax = 0;
+      dispatchTimeMax = 0;
+      for (uint8_t i = 0; i < INVERTERS; i++)
+      {
+        growattInterface.StatisticsToJson(i, value);
+        publishText(inverterTopics[i][topicStatistics], value);
+      }
+#ifdef MODBUS_SHARED_BUS
+      growattInterface.BusStatisticsToJson(value);
+      publishText(topics[topicDiagnostics], value);
 #endif
-      snprintf(topic, MAX_ROOT_TOPIC_LENGTH, "%s/%s", topicRoot, "status");
-      mqtt.publish(topic, value);
 #ifdef DEBUG_MQTT
-      Serial.println(value);
-      Serial.println(F("MQTT status sent"));
+      SerialDebug.println(value);
+      SerialDebug.println(F("MQTT status sent"));
 #endif      
     }
     updateStatus = false;
@@ -659,12 +1010,21 @@ void loop()
   {
     if (WiFi.status() != WL_CONNECTED)
     {
-      Serial.println("Reconnecting to wifi...");
+      SerialDebug.println("Reconnecting to wifi...");
       WiFi.reconnect();
       uptime = 0;
     }
     checkWifi = false;
   }
 
-  
+  // The messages of this pass leave in as few TCP segments as possible
+  if (strlen(mqtt_server) > 0)
+  {
+    mqtt.flush();
+  }
+
+  if (micros() - loopStart > loopTimeMax)
+  {
+    loopTimeMax = micros() - loopStart;
+  }
 }
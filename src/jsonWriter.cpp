@@ -0,0 +1,165 @@
+#include "jsonWriter.h"
+
+jsonWriter::jsonWriter() {
+  cursor = NULL;
+  end = NULL;
+  out = NULL;
+  echo = NULL;
+  chunkLength = 0;
+  count = 0;
+  truncated = false;
+}
+
+jsonWriter::jsonWriter(char *buffer, size_t size) {
+  cursor = buffer;
+  end = buffer + size - 1;
+  out = NULL;
+  echo = NULL;
+  chunkLength = 0;
+  count = 0;
+  truncated = false;
+  *cursor = '\0';
+}
+
+jsonWriter::jsonWriter(Print &stream, Print *_echo) {
+  cursor = NULL;
+  end = NULL;
+  out = &stream;
+  echo = _echo;
+  chunkLength = 0;
+  count = 0;
+  truncated = false;
+}
+
+void jsonWriter::put(char c) {
+  if (out)
+  {
+    if (truncated)
+      return;
+    chunk[chunkLength++] = c;
+    if (chunkLength == JSON_CHUNK_SIZE)
+      flush();
+  }
+  else if (cursor)
+  {
+    if (cursor == end)
+    {
+      truncated = true;
+      return;
+    }
+    *cursor++ = c;
+    *cursor = '\0';
+  }
+  count++;
+}
+
+// The bytes the Print did not take are not counted, the text is cut there
+void jsonWriter::flush() {
+  if (!out || chunkLength == 0)
+    return;
+  size_t written = out->write(chunk, chunkLength);
+  if (echo)
+    echo->write(chunk, written);
+  if (written < chunkLength)
+  {
+    count -= chunkLength - written;
+    truncated = true;
+  }
+  chunkLength = 0;
+}
+
+void jsonWriter::append(char c) {
+  put(c);
+}
+
+void jsonWriter::append(const char *text) {
+  while (*text)
+  {
+    put(*text++);
+  }
+}
+
+void jsonWriter::appendKey(const char *name) {
+  put('"');
+  append(name);
+  put('"');
+  put(':');
+}
+
+void jsonWriter::appendString(const char *text) {
+  put('"');
+  append(text);
+  put('"');
+}
+
+void jsonWriter::appendUnsigned(uint32_t value) {
+  char digits[10];
+  uint8_t count = 0;
+
+  do
+  {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (count)
+  {
+    put(digits[--count]);
+  }
+}
+
+void jsonWriter::appendSigned(int32_t value) {
+  if (value < 0)
+  {
+    put('-');
+    appendUnsigned(-(uint32_t)value);
+  }
+  else
+  {
+    appendUnsigned(value);
+  }
+}
+
+// The digits are produced from the integer, the 32 bit path covers all but the largest counters
+void jsonWriter::appendFixed(int64_t value, uint8_t decimals) {
+  char digits[20];
+  uint8_t count = 0;
+  uint64_t magnitude = value;
+
+  if (value < 0)
+  {
+    put('-');
+    magnitude = -(uint64_t)value;
+  }
+  if (magnitude <= UINT32_MAX)
+  {
+    uint32_t small = magnitude;
+    do
+    {
+      digits[count++] = '0' + small % 10;
+      small /= 10;
+    } while (small || count <= decimals);
+  }
+  else
+  {
+    do
+    {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude || count <= decimals);
+  }
+  while (count)
+  {
+    if (count == decimals)
+      put('.');
+    put(digits[--count]);
+  }
+}
+
+void jsonWriter::appendHex(uint16_t value) {
+  static const char hex[] = "0123456789ABCDEF";
+
+  for (int8_t shift = 12; shift >= 0; shift -= 4)
+  {
+    put(hex[(value >> shift) & 0x0f]);
+  }
+}
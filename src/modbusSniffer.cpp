@@ -0,0 +1,166 @@
+#include "modbusSniffer.h"
+#include "util/crc16.h"
+
+// frameSilence in us (t3.5, see ModbusMaster::frameSilence()), responseTimeout in ms
+void modbusSniffer::begin(uint16_t _frameSilence, uint16_t _responseTimeout) {
+  frameSilence = _frameSilence;
+  responseTimeout = _responseTimeout;
+  length = 0;
+  delivered = 0;
+  requestPending = false;
+}
+
+void modbusSniffer::drop(uint16_t size) {
+  memmove(frame, frame + size, length - size);
+  length -= size;
+}
+
+// Size of the valid frame at the start of the buffer. 0 while it may still grow into one (*more),
+// or when no frame fits: then the first byte is not the start of a frame.
+uint16_t modbusSniffer::frameLength(bool *more) {
+  uint16_t sizes[2] = { 0, 0 };
+
+  *more = length < 2;
+  if (*more)
+  {
+    return 0;
+  }
+  if (frame[1] & 0x80)
+  {
+    sizes[0] = 5;                                       // exception response
+  }
+  else
+  {
+    switch (frame[1])
+    {
+      case 0x03:
+      case 0x04:
+        sizes[0] = 8;                                   // request
+        sizes[1] = (length >= 3) ? 5 + frame[2] : UINT16_MAX;
+        break;
+      case 0x06:
+        sizes[0] = 8;                                   // request and response are the same
+        break;
+      case 0x10:
+        sizes[0] = 8;                                   // response
+        sizes[1] = (length >= 7) ? 9 + frame[6] : UINT16_MAX;
+        break;
+    }
+  }
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    if (sizes[i] == 0 || (sizes[i] > maxFrameSize && sizes[i] != UINT16_MAX))
+      continue;
+    if (sizes[i] > length)
+    {
+      *more = true;
+      continue;
+    }
+    // the CRC over a frame including its CRC is 0
+    if (crc16_update_block(0xFFFF, frame, sizes[i]) == 0)
+      return sizes[i];
+  }
+  return 0;
+}
+
+// Notes a request, true when the frame is the response with the registers of the request before it
+bool modbusSniffer::handleFrame(uint16_t size) {
+  uint8_t function = frame[1] & 0x7F;
+  bool matches = requestPending && frame[0] == requestSlave && function == requestFunction;
+  bool response;
+
+  if (frame[1] & 0x80)
+    response = true;
+  else if (function == 0x03 || function == 0x04)
+    response = size & 1;                                // 5 + an even byte count, the request has 8
+  else if (function == 0x10)
+    response = size == 8;
+  else
+    response = matches;                                 // 0x06 echoes the request
+
+  if (!response)
+  {
+    statistics.requests++;
+    requestPending = frame[0] != 0;                     // a broadcast is not answered
+    requestTime = millis();
+    requestSlave = frame[0];
+    requestFunction = function;
+    requestStart = (frame[2] << 8) | frame[3];
+    requestCount = (function == 0x06) ? 1 : (frame[4] << 8) | frame[5];
+    return false;
+  }
+  statistics.responses++;
+  requestPending = false;                               // only one request is outstanding on the bus
+  if (!matches)
+  {
+    return false;
+  }
+  return (function == 0x03 || function == 0x04) && !(frame[1] & 0x80) && frame[2] == 2 * requestCount;
+}
+
+// Reads the bytes that arrived on the bus. true when they completed the response to a register read,
+// its registers are then available until the next call.
+bool modbusSniffer::poll(Stream &port) {
+  uint16_t size;
+  bool more;
+
+  drop(delivered);
+  delivered = 0;
+  while (port.available())
+  {
+    if (length == maxFrameSize)
+    {
+      drop(1);
+    }
+    frame[length++] = port.read();
+    lastByte = micros();
+    while (length)
+    {
+      size = frameLength(&more);
+      if (size && handleFrame(size))
+      {
+        delivered = size;
+        return true;
+      }
+      if (size)
+        drop(size);
+      else if (more)
+        break;
+      else
+        drop(1);
+    }
+  }
+  // nothing arrived for t3.5: the rest can not become a frame any more, e.g. after a collision
+  if (length && micros() - lastByte > frameSilence)
+  {
+    length = 0;
+    statistics.brokenFrames++;
+  }
+  return false;
+}
+
+// Our transaction was broken by the other master. ModbusMaster may have taken its request for our
+// response, so the bus is kept free as if a request of the other master was seen, until a response
+// comes or the response timeout.
+void modbusSniffer::collision() {
+  requestPending = true;
+  requestTime = millis();
+  requestSlave = 0;                                     // no response matches
+}
+
+// true when the bus is free for a request: no frame is coming in, no response is outstanding and the
+// line was silent for gap ms, at least t3.5
+bool modbusSniffer::idle(uint16_t gap) {
+  uint32_t silence = (uint32_t)gap * 1000;
+
+  if (requestPending && millis() - requestTime > responseTimeout)
+  {
+    requestPending = false;                             // the response was lost
+  }
+  if (silence < frameSilence)
+  {
+    silence = frameSilence;
+  }
+  return length == delivered && !requestPending && micros() - lastByte >= silence;
+}
@@ -0,0 +1,128 @@
+#include <string.h>
+#include "mqttCommand.h"
+
+static bool sameText(const uint8_t *payload, unsigned int length, const char *text)
+{
+  unsigned int i;
+
+  for (i = 0; i < length && text[i]; i++)
+  {
+    uint8_t c = payload[i];
+    if (c >= 'a' && c <= 'z')
+      c -= 'a' - 'A';
+    if (c != (uint8_t)text[i])
+      return false;
+  }
+  return i == length && text[i] == '\0';
+}
+
+static int8_t hexDigit(uint8_t c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+bool parseArgument(commandArgument argument, const uint8_t *payload, unsigned int length, int32_t *value)
+{
+  const uint8_t *end;
+  int64_t number = 0;
+  bool negative = false;
+  uint8_t digits = 0;
+
+  while (length && (*payload == ' ' || *payload == '\t'))
+  {
+    payload++;
+    length--;
+  }
+  while (length && (payload[length - 1] == ' ' || payload[length - 1] == '\t' || payload[length - 1] == '\r' || payload[length - 1] == '\n'))
+  {
+    length--;
+  }
+  end = payload + length;
+
+  switch (argument)
+  {
+    case argPayload:
+      *value = length;
+      return true;
+
+    case argOnOff:
+      if (sameText(payload, length, "ON") || sameText(payload, length, "1"))
+        *value = 1;
+      else if (sameText(payload, length, "OFF") || sameText(payload, length, "0"))
+        *value = 0;
+      else
+        return false;
+      return true;
+
+    case argHex:
+      if (length > 2 && payload[0] == '0' && (payload[1] == 'x' || payload[1] == 'X'))
+        payload += 2;
+      for (; payload < end; payload++)
+      {
+        int8_t digit = hexDigit(*payload);
+        if (digit < 0 || ++digits > 4)
+          return false;
+        number = number * 16 + digit;
+      }
+      if (digits == 0)
+        return false;
+      *value = number;
+      return true;
+
+    case argInteger:
+    case argTenths:
+      if (payload < end && (*payload == '-' || *payload == '+'))
+      {
+        negative = (*payload == '-');
+        payload++;
+      }
+      for (; payload < end && *payload >= '0' && *payload <= '9'; payload++)
+      {
+        if (++digits > 9)
+          return false;
+        number = number * 10 + (*payload - '0');
+      }
+      if (digits == 0)
+        return false;
+      if (argument == argTenths)
+      {
+        number *= 10;
+        if (payload < end && *payload == '.')
+        {
+          payload++;
+          if (payload < end && *payload >= '0' && *payload <= '9')
+            number += *payload++ - '0';
+        }
+      }
+      if (payload != end)
+        return false;
+      *value = negative ? -number : number;
+      return true;
+  }
+  return false;
+}
+
+const mqttCommand *findCommand(const mqttCommand *commands, uint8_t count, const char *suffix)
+{
+  uint8_t low = 0, high = count;
+
+  while (low < high)
+  {
+    uint8_t middle = (low + high) / 2;
+    int order = strcmp(suffix, commands[middle].suffix);
+
+    if (order == 0)
+      return &commands[middle];
+    if (order < 0)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return NULL;
+}
@@ -0,0 +1,160 @@
+#include "offlineStore.h"
+
+#define SPILL_FILE "/offline.bin"
+
+void offlineStore::begin() {
+#ifdef OFFLINE_SPILL_RECORDS
+  // without a file system the snapshots stay in RAM only
+  if (LittleFS.begin())
+  {
+    spill = LittleFS.open(SPILL_FILE, "w+");
+  }
+#endif
+}
+
+// Stores the snapshot behind the newest, making room by spilling or dropping the oldest one
+void offlineStore::push(const storedSnapshot &record) {
+  if (count == OFFLINE_RECORDS)
+  {
+#ifdef OFFLINE_SPILL_RECORDS
+    spillRecord(records[head]);
+#else
+    drop(0);
+#endif
+    head = (head + 1) % OFFLINE_RECORDS;
+    count--;
+  }
+  records[(head + count) % OFFLINE_RECORDS] = record;
+  count++;
+}
+
+#ifdef OFFLINE_SPILL_RECORDS
+// Appends the oldest snapshot in RAM to the file ring. Only the slot behind the last one written is ever
+// written, so the file grows one record at a time up to OFFLINE_SPILL_RECORDS.
+void offlineStore::spillRecord(const storedSnapshot &record) {
+  if (!spill)
+  {
+    drop(spillCount);
+    return;
+  }
+  if (spillCount == OFFLINE_SPILL_RECORDS)
+  {
+    spillHead = (spillHead + 1) % OFFLINE_SPILL_RECORDS;
+    spillCount--;
+    drop(0);
+  }
+  spill.seek((uint32_t)((spillHead + spillCount) % OFFLINE_SPILL_RECORDS) * sizeof(record));
+  if (spill.write((const uint8_t *)&record, sizeof(record)) != sizeof(record))
+  {
+    drop(spillCount);
+    return;
+  }
+  spillCount++;
+}
+#endif
+
+// Counts the snapshot at index, from the oldest, as lost. When it was published, its PUBACK is not for the
+// oldest snapshot still stored.
+void offlineStore::drop(uint16_t index) {
+  dropped++;
+  if (index < sent)
+  {
+    sent--;
+    droppedSent++;
+  }
+}
+
+// Copies the oldest snapshot, or the one skip places after it, to record. false when there are not that many.
+bool offlineStore::oldest(storedSnapshot &record, uint16_t skip) {
+#ifdef OFFLINE_SPILL_RECORDS
+  if (skip < spillCount)
+  {
+    spill.seek((uint32_t)((spillHead + skip) % OFFLINE_SPILL_RECORDS) * sizeof(record));
+    return spill.read((uint8_t *)&record, sizeof(record)) == sizeof(record);
+  }
+  skip -= spillCount;
+#endif
+  if (skip >= count)
+  {
+    return false;
+  }
+  record = records[(head + skip) % OFFLINE_RECORDS];
+  return true;
+}
+
+// Removes the oldest snapshot, once its PUBACK came
+void offlineStore::pop() {
+  if (sent)
+  {
+    sent--;
+  }
+#ifdef OFFLINE_SPILL_RECORDS
+  if (spillCount)
+  {
+    spillHead = (spillHead + 1) % OFFLINE_SPILL_RECORDS;
+    spillCount--;
+    return;
+  }
+#endif
+  if (count)
+  {
+    head = (head + 1) % OFFLINE_RECORDS;
+    count--;
+  }
+}
+
+// Hands the stored snapshots that were not yet published to publish(), oldest first. OFFLINE_DRAIN_BATCH snapshots
+// every OFFLINE_DRAIN_INTERVAL leave in few TCP segments without crowding out the live data and the commands.
+// A published snapshot stays stored until acknowledge(), one that publish() refused is offered again on the next
+// pass. Returns the number published.
+uint8_t offlineStore::drain(bool (*publish)(const storedSnapshot &record)) {
+  storedSnapshot record;
+  uint8_t published = 0;
+
+  if (size() <= sent || millis() - lastDrain < OFFLINE_DRAIN_INTERVAL)
+  {
+    return 0;
+  }
+  lastDrain = millis();
+  while (published < OFFLINE_DRAIN_BATCH && oldest(record, sent))
+  {
+    if (!publish(record))
+      break;
+    sent++;
+    published++;
+  }
+  return published;
+}
+
+// The broker acknowledged the count oldest published snapshots, they are removed
+void offlineStore::acknowledge(uint8_t count) {
+  while (count--)
+  {
+    if (droppedSent)
+      droppedSent--;
+    else if (sent)
+      pop();
+  }
+}
+
+// The connection was lost before the PUBACKs, the next drain() passes publish those snapshots again
+void offlineStore::resend() {
+  sent = 0;
+  droppedSent = 0;
+}
+
+uint16_t offlineStore::size() {
+#ifdef OFFLINE_SPILL_RECORDS
+  return count + spillCount;
+#else
+  return count;
+#endif
+}
+
+// Snapshots overwritten while the store was full since the last call
+uint32_t offlineStore::droppedSnapshots() {
+  uint32_t lost = dropped;
+
+  dropped = 0;
+  return lost;
+}
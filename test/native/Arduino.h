@@ -0,0 +1,92 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// The part of the Arduino API that the portable modules of src/ use, for the native test environment.
+// Time is simulated: every call of micros() or millis() takes 1 us, so busy waits end, and the
+// tests move the clock on with nativeAdvance().
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define INPUT  0
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+inline uint16_t word(uint16_t w) { return w; }
+inline uint16_t word(uint8_t h, uint8_t l) { return (h << 8) | l; }
+
+inline unsigned long nativeMicros = 0;
+
+inline unsigned long micros() { return ++nativeMicros; }
+inline unsigned long millis() { return ++nativeMicros / 1000; }
+inline void nativeAdvance(unsigned long us) { nativeMicros += us; }
+inline void delay(unsigned long ms) { nativeMicros += ms * 1000; }
+inline void delayMicroseconds(unsigned int us) { nativeMicros += us; }
+inline void yield() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline long random(long howbig) { return howbig ? rand() % howbig : 0; }
+
+class String : public std::string {
+  public:
+    String() {}
+    String(const char *text) : std::string(text) {}
+    String(uint8_t value) : std::string(std::to_string(value)) {}
+    String &operator=(const char *text) { assign(text); return *this; }
+    String &operator=(uint8_t value) { assign(std::to_string(value)); return *this; }
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      size_t n = 0;
+      while (size-- && write(*buffer++))
+        n++;
+      return n;
+    }
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) {}
+    void swap() {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t data) override { return 1; }
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,100 @@
+// AsyncClient of ESPAsyncTCP for the host tests: a loopback to a broker stub in the test. What the client adds and
+// sends goes to wire; the stub completes the handshake, answers through deliver() and acknowledges the sent bytes,
+// which free the send buffer of window bytes like the TCP ACKs do. The handlers run at once, there is no TCP task.
+#ifndef ESPASYNCTCP_H
+#define ESPASYNCTCP_H
+
+#include <functional>
+#include <vector>
+#include "Arduino.h"
+
+#define ASYNC_WRITE_FLAG_COPY 0x01
+
+class AsyncClient;
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+typedef std::function<void(void *, AsyncClient *, int8_t error)> AcErrorHandler;
+typedef std::function<void(void *, AsyncClient *, void *data, size_t len)> AcDataHandler;
+
+class AsyncClient {
+  private:
+    AcConnectHandler connectHandler, disconnectHandler;
+    AcErrorHandler errorHandler;
+    AcDataHandler dataHandler;
+    void *connectArg = NULL, *disconnectArg = NULL, *errorArg = NULL, *dataArg = NULL;
+    bool pending = false;           // handshake started
+    bool up = false;
+    std::vector<uint8_t> staged;    // added, not yet sent
+    size_t unacked = 0;             // sent, not yet acknowledged by the peer
+
+  public:
+    // stub side
+    std::vector<uint8_t> wire;      // bytes sent to the broker
+    size_t window = 2920;           // send buffer, TCP_SND_BUF of lwIP on the ESP8266
+    bool refuse = false;            // the next handshake fails
+    uint32_t sends = 0;
+
+    void onConnect(AcConnectHandler handler, void *arg = NULL) { connectHandler = handler; connectArg = arg; }
+    void onDisconnect(AcConnectHandler handler, void *arg = NULL) { disconnectHandler = handler; disconnectArg = arg; }
+    void onError(AcErrorHandler handler, void *arg = NULL) { errorHandler = handler; errorArg = arg; }
+    void onData(AcDataHandler handler, void *arg = NULL) { dataHandler = handler; dataArg = arg; }
+
+    bool connect(const char *host, uint16_t port) {
+      if (up || pending)
+        return false;
+      pending = true;
+      return true;
+    }
+    void close(bool now = false) {
+      if (!up && !pending)
+        return;
+      up = pending = false;
+      staged.clear();
+      unacked = 0;
+      if (disconnectHandler)
+        disconnectHandler(disconnectArg, this);
+    }
+    bool connected() { return up; }
+    size_t space() { return up && window > staged.size() + unacked ? window - staged.size() - unacked : 0; }
+    size_t add(const char *data, size_t size, uint8_t flags = 0) {
+      if (!(flags & ASYNC_WRITE_FLAG_COPY))
+        abort();                    // the queue of the client is reused at once
+      size = min(size, space());
+      staged.insert(staged.end(), data, data + size);
+      return size;
+    }
+    bool send() {
+      wire.insert(wire.end(), staged.begin(), staged.end());
+      unacked += staged.size();
+      staged.clear();
+      sends++;
+      return true;
+    }
+
+    // stub side: ends the handshake, delivers the answer in segments of chunk bytes, acknowledges, drops
+    void complete() {
+      if (!pending)
+        return;
+      pending = false;
+      if (refuse)
+      {
+        if (errorHandler)
+          errorHandler(errorArg, this, -14);
+        if (disconnectHandler)
+          disconnectHandler(disconnectArg, this);
+        return;
+      }
+      up = true;
+      if (connectHandler)
+        connectHandler(connectArg, this);
+    }
+    void deliver(const std::vector<uint8_t> &data, size_t chunk) {
+      for (size_t i = 0; i < data.size() && up; i += chunk)
+      {
+        dataHandler(dataArg, this, (void *)(data.data() + i), min(chunk, data.size() - i));
+      }
+    }
+    void acknowledge() { unacked = 0; }
+    void drop() { close(); }
+};
+
+#endif
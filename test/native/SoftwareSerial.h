@@ -0,0 +1,18 @@
+#ifndef SOFTWARESERIAL_H
+#define SOFTWARESERIAL_H
+
+#include "Arduino.h"
+
+// Never sends or receives, the native tests hand their own line to initGrowatt()
+class SoftwareSerial : public Stream {
+  public:
+    SoftwareSerial(int8_t rx, int8_t tx, bool invert) {}
+    void begin(unsigned long baud) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t data) override { return 1; }
+    using Print::write;
+};
+
+#endif
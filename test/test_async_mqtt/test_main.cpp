@@ -0,0 +1,346 @@
+// asyncMqtt against a broker stub on the loopback AsyncClient of test/native: login, publish, received messages
+// in any segmentation, the PUBACKs handed to the offlineStore, the stored snapshots published again after a
+// reconnect when they do not all fit at once, a packet with a broken length field that drops the connection, and
+// the keepalive.
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include <ESPAsyncTCP.h>
+#include "asyncMqtt.h"
+#include "offlineStore.h"
+
+#define BUFFER_SIZE 128
+#define OUTPUT_SIZE 2048
+
+// A packet the client sent, as parsed by the stub
+struct packet
+{
+  uint8_t header;
+  std::vector<uint8_t> body;
+  uint16_t word(size_t at) const { return (body[at] << 8) | body[at + 1]; }
+  std::string topic() const { return std::string((const char *)body.data() + 2, word(0)); }
+  uint16_t packetId() const { return word(2 + word(0)); }
+  char payload() const { return body[2 + word(0) + 2]; }    // first payload byte of a QoS 1 message
+};
+
+static asyncMqtt *mqtt;
+static offlineStore store;
+static size_t parsed;             // bytes of the wire taken apart
+static std::vector<packet> packets;
+static std::string received;      // topic and payload of the last message to the callback
+
+static void callback(char *topic, uint8_t *payload, unsigned int length) {
+  received = std::string(topic) + "=" + std::string((const char *)payload, length);
+}
+
+// The loopback client of asyncMqtt is the broker side
+struct asyncMqttTest {
+  static AsyncClient &client(asyncMqtt &mqtt) { return mqtt.client; }
+};
+
+static AsyncClient &tcp() {
+  return asyncMqttTest::client(*mqtt);
+}
+
+// Takes the new bytes on the wire apart into packets, a packet cut by the send buffer waits for its end
+static void brokerReceive() {
+  std::vector<uint8_t> &wire = tcp().wire;
+
+  while (parsed < wire.size())
+  {
+    size_t at = parsed + 1;
+    uint32_t length = 0;
+    uint8_t shift = 0;
+
+    do
+    {
+      if (at >= wire.size())
+        return;
+      length |= (uint32_t)(wire[at] & 0x7F) << shift;
+      shift += 7;
+    } while (wire[at++] & 0x80);
+    if (at + length > wire.size())
+      return;
+    packets.push_back({ wire[parsed], std::vector<uint8_t>(wire.begin() + at, wire.begin() + at + length) });
+    parsed = at + length;
+  }
+}
+
+static void brokerSend(std::vector<uint8_t> data, size_t chunk = 1460) {
+  tcp().deliver(data, chunk);
+}
+
+static void puback(uint16_t packetId) {
+  brokerSend({ 0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)packetId });
+}
+
+// connect() until the broker accepted the login
+static void login() {
+  TEST_ASSERT_TRUE(mqtt->connect("gateway", "user", "secret", "root/connection", 0, true, "offline"));
+  TEST_ASSERT_FALSE(mqtt->loop());
+  TEST_ASSERT_EQUAL(asyncMqtt::stateConnecting, mqtt->state());
+  tcp().complete();
+  mqtt->loop();
+  brokerReceive();
+  TEST_ASSERT_EQUAL_HEX8(0x10, packets.back().header);
+  brokerSend({ 0x20, 0x02, 0x00, 0x00 });
+  TEST_ASSERT_TRUE(mqtt->connected());
+}
+
+static void publishLarge(uint8_t qos, char fill) {
+  std::string payload(800, fill);
+
+  TEST_ASSERT_TRUE(mqtt->beginPublish("root/data/backlog", payload.size(), false, qos));
+  mqtt->write((const uint8_t *)payload.data(), payload.size());
+  TEST_ASSERT_TRUE(mqtt->endPublish());
+}
+
+// publishStored() of the sketch: the snapshot at time t is 800 bytes of 'a' + t
+static bool publishRecord(const storedSnapshot &record) {
+  std::string payload(800, 'a' + record.time);
+
+  return mqtt->beginPublish("root/data/backlog", payload.size(), false, 1) &&
+         mqtt->write((const uint8_t *)payload.data(), payload.size()) == payload.size() && mqtt->endPublish();
+}
+
+static void storeRecord(uint32_t time) {
+  storedSnapshot record = {};
+
+  record.time = time;
+  store.push(record);
+}
+
+void setUp() {
+  mqtt = new asyncMqtt("broker", 1883);
+  mqtt->setBufferSize(BUFFER_SIZE);
+  mqtt->setOutputBufferSize(OUTPUT_SIZE);
+  mqtt->setCallback(callback);
+  parsed = 0;
+  packets.clear();
+  received.clear();
+}
+void tearDown() {
+  delete mqtt;
+}
+
+void test_login_and_publish() {
+  login();
+  const std::vector<uint8_t> &body = packets.back().body;
+  TEST_ASSERT_EQUAL(4, body[6]);                        // protocol level 3.1.1
+  TEST_ASSERT_EQUAL_HEX8(0xE6, body[7]);                // user, password, will retained, clean session
+
+  TEST_ASSERT_TRUE(mqtt->publish("root/status", "{\"rssi\":-60}"));
+  TEST_ASSERT_TRUE(mqtt->subscribe("root/write/#"));
+  uint32_t sends = tcp().sends;
+  mqtt->flush();
+  TEST_ASSERT_EQUAL(sends + 1, tcp().sends);            // both in one segment
+  brokerReceive();
+  TEST_ASSERT_EQUAL(3, packets.size());
+  TEST_ASSERT_EQUAL_HEX8(0x30, packets[1].header);
+  TEST_ASSERT_EQUAL_STRING("root/status", packets[1].topic().c_str());
+  TEST_ASSERT_EQUAL_HEX8(0x82, packets[2].header);
+}
+
+// a queue of two large messages leaves in writes of one segment each, and each one is counted
+void test_segment_writes() {
+  login();
+  uint32_t sends = tcp().sends;
+  size_t wire = tcp().wire.size();
+  publishLarge(0, 'a');
+  publishLarge(0, 'b');
+  mqtt->flush();
+  size_t queued = tcp().wire.size() - wire;
+  uint32_t segments = (queued + MQTT_SEGMENT_SIZE - 1) / MQTT_SEGMENT_SIZE;
+
+  printf("%u bytes in %lu segments\n", (unsigned)queued, (unsigned long)mqtt->getSentSegments());
+  TEST_ASSERT_EQUAL(sends + segments, tcp().sends);
+  TEST_ASSERT_EQUAL(tcp().sends, mqtt->getSentSegments());
+  TEST_ASSERT_EQUAL(tcp().wire.size(), mqtt->getSentBytes());
+  brokerReceive();
+  TEST_ASSERT_EQUAL(3, packets.size());
+}
+
+// a message to the gateway in segments of every size from 1 byte up
+void test_receive_segments() {
+  std::vector<uint8_t> message = { 0x30, 0x00, 0x00, 0x0D };
+
+  login();
+  for (char c : std::string("root/write/on"))
+    message.push_back(c);
+  message[3] = message.size() - 4;
+  message.push_back('1');
+  message[1] = message.size() - 2;
+  for (size_t chunk = 1; chunk <= message.size(); chunk++)
+  {
+    received.clear();
+    brokerSend(message, chunk);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    TEST_ASSERT_EQUAL_STRING("root/write/on=1", received.c_str());
+  }
+}
+
+// a packet larger than the buffer is skipped, the next one still arrives
+void test_oversized_packet() {
+  std::vector<uint8_t> large = { 0x30, 0xC8, 0x01, 0x00, 0x01, 'x' };
+
+  login();
+  large.resize(2 + 200 + 1, 'y');
+  brokerSend(large, 7);
+  brokerSend({ 0x30, 0x05, 0x00, 0x01, 't', 'o', 'k' });
+  mqtt->loop();
+  TEST_ASSERT_EQUAL_STRING("t=ok", received.c_str());
+  TEST_ASSERT_TRUE(mqtt->connected());
+}
+
+// the slot of a QoS 1 message is free once acknowledged() reported its PUBACK, in the order of the messages
+void test_puback_frees_slot() {
+  login();
+  for (uint8_t i = 0; i < MQTT_INFLIGHT; i++)
+  {
+    publishLarge(1, 'a' + i);
+    mqtt->flush();
+    tcp().acknowledge();
+  }
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT, mqtt->inflightMessages());
+  TEST_ASSERT_FALSE(mqtt->beginPublish("root/data/backlog", 10, false, 1));
+  brokerReceive();
+  puback(packets[2].packetId());
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT - 1, mqtt->inflightMessages());
+  TEST_ASSERT_EQUAL(0, mqtt->acknowledged());           // waits for the PUBACK of the first message
+  puback(packets[1].packetId());
+  TEST_ASSERT_EQUAL(2, mqtt->acknowledged());
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT - 2, mqtt->inflightMessages());
+  publishLarge(1, 'e');
+}
+
+// The connection is lost with three stored snapshots waiting for their PUBACK. After the reconnect the store publishes
+// them again, from the snapshots rather than from a copy of the packets. They do not fit into the queue and the send
+// buffer at once: they go out over several drain passes, before a snapshot stored later, and their PUBACKs empty
+// the store.
+void test_reconnect_resend() {
+  std::vector<char> published;
+
+  login();
+  for (uint32_t t = 0; t < MQTT_INFLIGHT; t++)
+    storeRecord(t);
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT, store.drain(publishRecord));
+  for (uint8_t i = 0; i < 2; i++)                       // more than the send buffer
+  {
+    mqtt->flush();
+    tcp().acknowledge();
+  }
+  brokerReceive();
+  TEST_ASSERT_EQUAL(1 + MQTT_INFLIGHT, packets.size());
+  puback(packets[1].packetId());
+  store.acknowledge(mqtt->acknowledged());
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT - 1, store.size());
+
+  tcp().drop();
+  TEST_ASSERT_FALSE(mqtt->loop());
+  TEST_ASSERT_EQUAL(asyncMqtt::stateConnectionLost, mqtt->state());
+  storeRecord(MQTT_INFLIGHT);
+  tcp().window = 300;
+  login();
+  TEST_ASSERT_EQUAL(0, mqtt->inflightMessages());       // a clean session
+  store.resend();
+  packets.clear();
+
+  uint8_t passes = 0;
+  while (store.size())
+  {
+    TEST_ASSERT_LESS_THAN(50, ++passes);
+    nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    store.acknowledge(mqtt->acknowledged());
+    store.drain(publishRecord);
+    mqtt->flush();
+    tcp().acknowledge();
+    brokerReceive();
+    for (const packet &p : packets)
+    {
+      TEST_ASSERT_EQUAL_HEX8(0x32, p.header);           // PUBLISH, QoS 1
+      published.push_back(p.payload());
+      puback(p.packetId());
+    }
+    packets.clear();
+  }
+  printf("%u snapshots published after the reconnect in %u drain passes\n", (unsigned)published.size(), passes);
+  TEST_ASSERT_EQUAL(MQTT_INFLIGHT, published.size());
+  for (uint8_t i = 0; i < published.size(); i++)
+    TEST_ASSERT_EQUAL('b' + i, published[i]);
+  TEST_ASSERT_EQUAL(0, mqtt->inflightMessages());
+}
+
+// five bytes of remaining length with the continuation bit: the connection is dropped
+void test_broken_length() {
+  login();
+  brokerSend({ 0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x00 });
+  TEST_ASSERT_EQUAL(asyncMqtt::stateConnectionLost, mqtt->state());
+  TEST_ASSERT_FALSE(mqtt->loop());
+  TEST_ASSERT_FALSE(tcp().connected());
+
+  // the next connection starts with a clean parser
+  login();
+  brokerSend({ 0x30, 0x05, 0x00, 0x01, 't', 'o', 'k' });
+  mqtt->loop();
+  TEST_ASSERT_EQUAL_STRING("t=ok", received.c_str());
+}
+
+// a ping that waits for room in the send buffer does not time out; once sent, it has MQTT_KEEPALIVE_TIME for its answer
+void test_keepalive() {
+  login();
+  packets.clear();
+  tcp().acknowledge();
+  tcp().window = 0;
+  nativeAdvance((MQTT_KEEPALIVE_TIME * 1000UL + 1) * 1000UL);
+  TEST_ASSERT_TRUE(mqtt->loop());
+  nativeAdvance(1000);
+  TEST_ASSERT_TRUE(mqtt->loop());
+  nativeAdvance(2 * MQTT_KEEPALIVE_TIME * 1000000UL);
+  TEST_ASSERT_TRUE(mqtt->loop());
+  brokerReceive();
+  TEST_ASSERT_EQUAL(0, packets.size());
+
+  tcp().window = 2920;
+  mqtt->flush();
+  brokerReceive();
+  TEST_ASSERT_EQUAL(1, packets.size());
+  TEST_ASSERT_EQUAL_HEX8(0xC0, packets[0].header);      // PINGREQ
+  nativeAdvance(MQTT_KEEPALIVE_TIME * 1000000UL);
+  TEST_ASSERT_TRUE(mqtt->loop());
+  brokerSend({ 0xD0, 0x00 });                           // PINGRESP
+  nativeAdvance(MQTT_KEEPALIVE_TIME * 1000000UL);
+  TEST_ASSERT_TRUE(mqtt->loop());
+
+  // the next ping is not answered
+  nativeAdvance(2000);
+  TEST_ASSERT_TRUE(mqtt->loop());
+  brokerReceive();
+  TEST_ASSERT_EQUAL(2, packets.size());
+  nativeAdvance((MQTT_KEEPALIVE_TIME * 1000UL + 1) * 1000UL);
+  TEST_ASSERT_FALSE(mqtt->loop());
+  TEST_ASSERT_EQUAL(asyncMqtt::stateConnectionTimeout, mqtt->state());
+}
+
+void test_connect_timeout() {
+  TEST_ASSERT_TRUE(mqtt->connect("gateway", NULL, NULL, NULL, 0, false, NULL));
+  nativeAdvance((MQTT_CONNECT_TIMEOUT + 1) * 1000UL);
+  TEST_ASSERT_FALSE(mqtt->loop());
+  TEST_ASSERT_EQUAL(asyncMqtt::stateConnectionTimeout, mqtt->state());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_login_and_publish);
+  RUN_TEST(test_segment_writes);
+  RUN_TEST(test_receive_segments);
+  RUN_TEST(test_oversized_packet);
+  RUN_TEST(test_puback_frees_slot);
+  RUN_TEST(test_reconnect_resend);
+  RUN_TEST(test_broken_length);
+  RUN_TEST(test_keepalive);
+  RUN_TEST(test_connect_timeout);
+  return UNITY_END();
+}
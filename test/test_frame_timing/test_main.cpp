@@ -0,0 +1,109 @@
+// Time to failure of a read on the simulated clock: a slave that does not answer fails after the response
+// timeout, a response cut short as soon as the line stayed silent for t3.5. The simulated inverter answers
+// at once, so the times are the waiting of the master and the request gaps only.
+#include <unity.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+
+#define POLL_STEP 50              // us of line time per poll()
+
+// The simulated inverter answers with the first bytes of its responses only
+class truncatingLine : public Stream {
+  private:
+    growattSimulator &slave;
+    uint16_t received = 0;        // bytes of the current response
+
+  public:
+    uint16_t limit = 0xFFFF;
+
+    truncatingLine(growattSimulator &_slave) : slave(_slave) {}
+    size_t write(uint8_t data) override {
+      received = 0;
+      return slave.write(data);
+    }
+    using Print::write;
+    int available() override { return received < limit ? min(slave.available(), limit - received) : 0; }
+    int read() override {
+      if (received >= limit)
+        return -1;
+      int data = slave.read();
+      if (data >= 0)
+        received++;
+      return data;
+    }
+    int peek() override { return received < limit ? slave.peek() : -1; }
+};
+
+static const uint8_t otherSlave[] = { 0xF7 };
+growattSimulator answering(slaveIds, INVERTERS);
+growattSimulator silent(otherSlave, 1);
+truncatingLine truncated(answering);
+
+// us of line time from the start of the read until it failed or succeeded
+static uint32_t timeToResult(Stream &line, uint8_t *result) {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+
+  growatt.initGrowatt(line);
+  nativeAdvance(MODBUS_REQUEST_GAP * 1000UL);
+  uint32_t start = micros();
+  growatt.beginReadHoldingRegisters(0);
+  while (!growatt.done())
+  {
+    growatt.poll();
+    nativeAdvance(POLL_STEP);
+  }
+  *result = growatt.result();
+  return micros() - start;
+}
+
+void setUp() {
+  truncated.limit = 0xFFFF;
+}
+void tearDown() {}
+
+void test_timings() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+
+  growatt.initGrowatt(answering);
+  TEST_ASSERT_EQUAL(MODBUS_RESPONSE_TIMEOUT, growatt.getResponseTimeout());
+  // t3.5 at 9600 baud: 3.5 characters of 11 bits
+  TEST_ASSERT_EQUAL(4010, growatt.getInterCharTimeout());
+}
+
+void test_answer() {
+  uint8_t result;
+  uint32_t time = timeToResult(truncated, &result);
+
+  printf("complete response: %lu us\n", (unsigned long)time);
+  TEST_ASSERT_EQUAL(growattIF::Success, result);
+}
+
+void test_silent_slave() {
+  uint8_t result;
+  uint32_t time = timeToResult(silent, &result);
+
+  printf("silent slave: failed after %lu us\n", (unsigned long)time);
+  TEST_ASSERT_EQUAL(ModbusMaster::ku8MBResponseTimedOut, result);
+  TEST_ASSERT_GREATER_OR_EQUAL(MODBUS_RESPONSE_TIMEOUT * 1000UL, time);
+  TEST_ASSERT_LESS_THAN(MODBUS_RESPONSE_TIMEOUT * 1000UL + 10000, time);
+}
+
+void test_truncated_frame() {
+  uint8_t result;
+
+  truncated.limit = 20;
+  uint32_t time = timeToResult(truncated, &result);
+
+  printf("truncated response: failed after %lu us\n", (unsigned long)time);
+  TEST_ASSERT_NOT_EQUAL(growattIF::Success, result);
+  TEST_ASSERT_LESS_THAN(10000, time);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_timings);
+  RUN_TEST(test_answer);
+  RUN_TEST(test_silent_slave);
+  RUN_TEST(test_truncated_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,228 @@
+// jsonWriter and the register messages against the snprintf() and strcat() formatter they replaced: the
+// output is byte-identical, except for the exact halfway cases of fields published with fewer decimals than
+// the register has, where float formatting rounded by the float representation. Prints the host speedup.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "Arduino.h"
+#include <ModbusMaster.h>
+#include "growattInterface.h"
+
+#define RAW_VALUES 200000           // raw values checked per field, 0 .. RAW_VALUES - 1
+#define MESSAGE_ROUNDS 20000
+#define TMP_BUFFER_SIZE 50          // of the former formatter
+
+// The private formatter of growattIF, through its test hook
+struct growattIFTest {
+  static uint8_t registersToJson(const registerDescriptor *map, uint8_t count, const int32_t *values, jsonWriter &writer) {
+    return growattIF::registersToJson(map, count, NULL, values, NULL, writer);
+  }
+};
+
+static char expected[1024];
+static char json[1024];
+
+// The former formatter: one snprintf() per field with a float scale, joined with strcat()
+static void formerRegistersToJson(const registerDescriptor *map, uint8_t count, const int32_t *values, char *out) {
+  char tmp_json[TMP_BUFFER_SIZE];
+
+  strcpy(out, "{");
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const registerDescriptor &reg = map[i];
+    const char *separator = i ? "," : "";
+    float scale = reg.multiplier;
+
+    for (uint8_t e = 0; e < reg.exponent; e++)
+      scale /= 10;
+    if (reg.format == fmtHex)
+      snprintf(tmp_json, TMP_BUFFER_SIZE, "%s\"%s\":\"%04X\"", separator, reg.name, (unsigned int)values[i]);
+    else if (reg.decimals == 0)
+      snprintf(tmp_json, TMP_BUFFER_SIZE, "%s\"%s\":%ld", separator, reg.name, (long)values[i]);
+    else
+      snprintf(tmp_json, TMP_BUFFER_SIZE, "%s\"%s\":%.*f", separator, reg.name, reg.decimals, values[i] * scale);
+    strcat(out, tmp_json);
+  }
+  strcat(out, "}");
+}
+
+// raw * multiplier ends on exactly half of the last published decimal
+static bool halfway(const registerDescriptor &reg, int32_t raw) {
+  if (reg.decimals >= reg.exponent)
+    return false;
+  int32_t divisor = 1;
+  for (uint8_t e = reg.decimals; e < reg.exponent; e++)
+    divisor *= 10;
+  return abs(raw * reg.multiplier) % divisor == divisor / 2;
+}
+
+static uint32_t checkMap(const registerDescriptor *map, uint8_t count) {
+  uint32_t checked = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const registerDescriptor &reg = map[i];
+
+    if (reg.format == fmtAscii)
+      continue;
+    for (int32_t raw = reg.isSigned ? 1 - RAW_VALUES : 0; raw < RAW_VALUES; raw++)
+    {
+      if (halfway(reg, raw) || (reg.format == fmtHex && raw > 0xFFFF))
+        continue;
+      jsonWriter writer(json, sizeof(json));
+      formerRegistersToJson(&reg, 1, &raw, expected);
+      growattIFTest::registersToJson(&reg, 1, &raw, writer);
+      TEST_ASSERT_EQUAL_STRING(expected, json);
+      checked++;
+    }
+  }
+  return checked;
+}
+
+// Takes up to limit bytes and counts the write() calls, like the MQTT client
+class recorder : public Print {
+  public:
+    std::string text;
+    size_t limit = SIZE_MAX;
+    uint32_t writes = 0;
+
+    size_t write(uint8_t data) override { return write(&data, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+      writes++;
+      size = min(size, limit - text.size());
+      text.append((const char *)buffer, size);
+      return size;
+    }
+};
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_append() {
+  jsonWriter writer(json, sizeof(json));
+
+  writer.appendKey("a");
+  writer.appendFixed(-5, 1);
+  writer.append(',');
+  writer.appendFixed(1234, 2);
+  writer.append(',');
+  writer.appendFixed(7, 0);
+  writer.append(',');
+  writer.appendFixed(10000000000LL, 1);
+  writer.append(',');
+  writer.appendSigned(INT32_MIN);
+  writer.append(',');
+  writer.appendUnsigned(UINT32_MAX);
+  writer.append(',');
+  writer.appendHex(0xBEEF);
+  writer.append(',');
+  writer.appendString("x");
+  TEST_ASSERT_EQUAL_STRING("\"a\":-0.5,12.34,7,1000000000.0,-2147483648,4294967295,BEEF,\"x\"", json);
+  TEST_ASSERT_EQUAL(strlen(json), writer.length());
+  TEST_ASSERT_FALSE(writer.overflow());
+}
+
+// the text is cut at the buffer and stays terminated, the counting writer gives the full length
+void test_overflow() {
+  char small[8];
+  jsonWriter writer(small, sizeof(small));
+  jsonWriter counter;
+
+  writer.append("{\"pv1voltage\":");
+  counter.append("{\"pv1voltage\":");
+  TEST_ASSERT_TRUE(writer.overflow());
+  TEST_ASSERT_EQUAL_STRING("{\"pv1vo", small);
+  TEST_ASSERT_EQUAL(7, writer.length());
+  TEST_ASSERT_EQUAL(14, counter.length());
+  TEST_ASSERT_FALSE(counter.overflow());
+}
+
+// the Print gets the text in chunks, the echo the same bytes
+void test_print_chunks() {
+  int32_t values[INPUT_REGISTER_COUNT] = {};
+  recorder client, echo;
+  jsonWriter counter;
+  jsonWriter writer(client, &echo);
+
+  growattIFTest::registersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, values, counter);
+  growattIFTest::registersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, values, writer);
+  TEST_ASSERT_EQUAL(counter.length() / JSON_CHUNK_SIZE, client.writes);
+  writer.flush();
+  TEST_ASSERT_EQUAL((counter.length() + JSON_CHUNK_SIZE - 1) / JSON_CHUNK_SIZE, client.writes);
+  TEST_ASSERT_EQUAL(counter.length(), client.text.size());
+  TEST_ASSERT_EQUAL(counter.length(), writer.length());
+  TEST_ASSERT_EQUAL_STRING(client.text.c_str(), echo.text.c_str());
+  TEST_ASSERT_FALSE(writer.overflow());
+}
+
+// a Print that stops taking bytes cuts the text, length() counts what it took
+void test_print_full() {
+  recorder client;
+  jsonWriter writer(client);
+
+  client.limit = 100;
+  for (uint8_t i = 0; i < 50; i++)
+  {
+    writer.append("abc");
+  }
+  writer.flush();
+  TEST_ASSERT_TRUE(writer.overflow());
+  TEST_ASSERT_EQUAL(100, writer.length());
+  TEST_ASSERT_EQUAL(100, client.text.size());
+}
+
+void test_fields_identical() {
+  uint32_t checked = checkMap(inputRegisterMap, INPUT_REGISTER_COUNT);
+
+  checked += checkMap(holdingRegisterMap, HOLDING_REGISTER_COUNT);
+  printf("%lu field values identical to the former formatter\n", (unsigned long)checked);
+}
+
+void test_message_speed() {
+  int32_t values[INPUT_REGISTER_COUNT];
+  size_t length = 0;
+
+  for (uint8_t i = 0; i < INPUT_REGISTER_COUNT; i++)
+  {
+    values[i] = i * 1237 + 45;
+  }
+  formerRegistersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, values, expected);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < MESSAGE_ROUNDS; r++)
+  {
+    formerRegistersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, values, expected);
+  }
+  double formerUs = elapsedUs(start) / MESSAGE_ROUNDS;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < MESSAGE_ROUNDS; r++)
+  {
+    jsonWriter writer(json, sizeof(json));
+    growattIFTest::registersToJson(inputRegisterMap, INPUT_REGISTER_COUNT, values, writer);
+    length = writer.length();
+  }
+  double writerUs = elapsedUs(start) / MESSAGE_ROUNDS;
+
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+  printf("input message, %u fields, %u bytes: snprintf+strcat %.2f us, jsonWriter %.2f us, %.1fx\n",
+         (unsigned)INPUT_REGISTER_COUNT, (unsigned)length, formerUs, writerUs, formerUs / writerUs);
+  TEST_ASSERT_LESS_THAN(formerUs, writerUs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_append);
+  RUN_TEST(test_overflow);
+  RUN_TEST(test_print_chunks);
+  RUN_TEST(test_print_full);
+  RUN_TEST(test_fields_identical);
+  RUN_TEST(test_message_speed);
+  return UNITY_END();
+}
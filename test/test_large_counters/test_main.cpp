@@ -0,0 +1,105 @@
+// 32 bit energy and time counters above 2^24, where a float has no digit left for the tenths: the published
+// values keep every digit of the register, read from the simulated inverter and written as JSON.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+
+growattSimulator simulator(slaveIds, INVERTERS);
+growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+static char json[1024];
+
+static void setCounter(uint16_t address, uint32_t raw) {
+  simulator.inputRegisters[address] = raw >> 16;
+  simulator.inputRegisters[address + 1] = raw & 0xffff;
+}
+
+// the energy group is read on every 6th update, see registerGroups
+static void publish() {
+  jsonWriter writer(json, sizeof(json));
+
+  for (uint8_t update = 0; update < registerGroups[grpEnergy].divider; update++)
+  {
+    growatt.beginReadInputRegisters(0);
+    while (!growatt.done())
+    {
+      growatt.poll();
+      nativeAdvance(100);
+    }
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.result());
+  }
+  growatt.SelectInputSnapshot(0);
+  growatt.InputRegistersToJson(0, writer);
+  TEST_ASSERT_FALSE(writer.overflow());
+}
+
+// the value of a field as written in the message
+static const char *field(const char *name) {
+  static char value[24];
+  char key[32];
+
+  snprintf(key, sizeof(key), "\"%s\":", name);
+  const char *start = strstr(json, key);
+  TEST_ASSERT_NOT_NULL(start);
+  start += strlen(key);
+  size_t length = strcspn(start, ",}");
+  memcpy(value, start, length);
+  value[length] = '\0';
+  return value;
+}
+
+// the former conversion: raw * 0.1f
+static const char *asFloat(uint32_t raw) {
+  static char value[24];
+
+  snprintf(value, sizeof(value), "%.1f", raw * 0.1f);
+  return value;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_energy_beyond_float() {
+  setCounter(55, 0x01000001);     // the start value of the simulator
+  setCounter(61, 20000001);
+  publish();
+  TEST_ASSERT_EQUAL_STRING("1677721.7", field("energytotal"));
+  TEST_ASSERT_EQUAL_STRING("2000000.1", field("pv1energytotal"));
+  // a float rounds both to the even neighbour
+  TEST_ASSERT_EQUAL_STRING("1677721.6", asFloat(0x01000001));
+  TEST_ASSERT_EQUAL_STRING("2000000.0", asFloat(20000001));
+}
+
+void test_full_range() {
+  setCounter(55, 0xFFFFFFFF);
+  setCounter(57, 0x7FFFFFFF);     // work time in 0.5 s
+  setCounter(65, 0x80000000);
+  publish();
+  TEST_ASSERT_EQUAL_STRING("429496729.5", field("energytotal"));
+  TEST_ASSERT_EQUAL_STRING("1073741823.5", field("totalworktime"));
+  TEST_ASSERT_EQUAL_STRING("214748364.8", field("pv2energytotal"));
+}
+
+// every count of a day counter over 2^24 is published apart from its neighbours
+void test_single_counts() {
+  char previous[24] = "";
+
+  for (uint32_t raw = 0x01000000 - 5; raw < 0x01000000 + 5; raw++)
+  {
+    setCounter(59, raw);
+    publish();
+    TEST_ASSERT_TRUE(strcmp(previous, field("pv1energytoday")) != 0);
+    strcpy(previous, field("pv1energytoday"));
+    TEST_ASSERT_EQUAL_UINT32(raw, (uint32_t)(atof(previous) * 10 + 0.5));
+  }
+}
+
+int main() {
+  growatt.initGrowatt(simulator);
+  UNITY_BEGIN();
+  RUN_TEST(test_energy_beyond_float);
+  RUN_TEST(test_full_range);
+  RUN_TEST(test_single_counts);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// Worst-case time the Modbus part of loop() holds the loop, on the simulated clock with the character timing
+// of a 9600 baud line: the blocking ReadInputRegisters() of the former loop() against the poll() of the
+// cooperative one. SoftwareSerial sends a request byte by byte while loop() waits, a hardware UART from its FIFO.
+#include <unity.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+
+#define CHARACTER_TIME 1146       // us of one character at 9600 baud, 11 bits
+#define TURNAROUND 30000          // us from the end of the request until the inverter answers
+#define LOOP_WORK 1000            // us of MQTT, OTA and web work in each pass of loop()
+#define UPDATES 20                // input register updates measured, one per second
+
+// Hands out the responses of the simulated inverter at the pace of the line
+class pacedLine : public Stream {
+  private:
+    growattSimulator &slave;
+    uint32_t answerStart = 0;     // us, the first response character is on the wire
+    uint16_t delivered = 0;
+
+  public:
+    bool softwareSerial = true;   // write() returns when the character was sent
+
+    pacedLine(growattSimulator &_slave) : slave(_slave) {}
+    size_t write(uint8_t data) override {
+      if (softwareSerial)
+        nativeAdvance(CHARACTER_TIME);
+      answerStart = nativeMicros + TURNAROUND;
+      delivered = 0;
+      return slave.write(data);
+    }
+    using Print::write;
+    int available() override {
+      int32_t onWire = (int32_t)(nativeMicros - answerStart) / CHARACTER_TIME;
+      return onWire > delivered ? min(slave.available(), onWire - delivered) : 0;
+    }
+    int read() override {
+      if (available() <= 0)
+        return -1;
+      delivered++;
+      return slave.read();
+    }
+    int peek() override { return available() > 0 ? slave.peek() : -1; }
+};
+
+growattSimulator simulator(slaveIds, INVERTERS);
+pacedLine line(simulator);
+
+static uint32_t passStart;
+static uint32_t worstPass;
+
+static void beginPass() {
+  passStart = nativeMicros;
+}
+
+static void endPass() {
+  if (nativeMicros - passStart > worstPass)
+    worstPass = nativeMicros - passStart;
+  nativeAdvance(LOOP_WORK);
+}
+
+// loop() before: the update is read in one call
+static uint32_t blockingLoop() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+  uint32_t nextUpdate = nativeMicros;
+
+  growatt.initGrowatt(line);
+  worstPass = 0;
+  for (uint8_t update = 0; update < UPDATES; update++)
+  {
+    while ((int32_t)(nativeMicros - nextUpdate) < 0)
+    {
+      beginPass();
+      endPass();
+    }
+    nextUpdate += 1000000;
+    beginPass();
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.ReadInputRegisters(0));
+    endPass();
+  }
+  return worstPass;
+}
+
+// loop() now: the update is started and advanced by poll() in each pass
+static uint32_t cooperativeLoop() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+  uint32_t nextUpdate = nativeMicros;
+  uint8_t updates = 0;
+  bool running = false;
+
+  growatt.initGrowatt(line);
+  worstPass = 0;
+  while (updates < UPDATES)
+  {
+    beginPass();
+    if (!running && (int32_t)(nativeMicros - nextUpdate) >= 0)
+    {
+      growatt.beginReadInputRegisters(0);
+      nextUpdate += 1000000;
+      running = true;
+    }
+    growatt.poll();
+    if (running && growatt.done())
+    {
+      TEST_ASSERT_EQUAL(growattIF::Success, growatt.result());
+      running = false;
+      updates++;
+    }
+    endPass();
+  }
+  return worstPass;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_software_serial() {
+  line.softwareSerial = true;
+  uint32_t blocking = blockingLoop();
+  uint32_t cooperative = cooperativeLoop();
+
+  printf("SoftwareSerial: worst loop() pass blocking %lu us, cooperative %lu us\n",
+         (unsigned long)blocking, (unsigned long)cooperative);
+  // the request is still sent in one pass, 8 characters
+  TEST_ASSERT_LESS_THAN(10 * CHARACTER_TIME, cooperative);
+  TEST_ASSERT_LESS_THAN(blocking / 5, cooperative);
+}
+
+void test_hardware_uart() {
+  line.softwareSerial = false;
+  uint32_t blocking = blockingLoop();
+  uint32_t cooperative = cooperativeLoop();
+
+  printf("hardware UART: worst loop() pass blocking %lu us, cooperative %lu us\n",
+         (unsigned long)blocking, (unsigned long)cooperative);
+  TEST_ASSERT_LESS_THAN(1000, cooperative);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_software_serial);
+  RUN_TEST(test_hardware_uart);
+  return UNITY_END();
+}
@@ -0,0 +1,179 @@
+// Fuzz test of the command parser: random payloads of the characters that matter are parsed with
+// parseArgument() and checked against a reference built on std::regex. The payload is followed by digits in
+// memory, so a read past its length changes the result. findCommand() is checked against a linear search.
+#include <unity.h>
+#include <algorithm>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include "mqttCommand.h"
+
+#define FUZZ_PAYLOADS 200000      // per argument type
+#define FUZZ_LOOKUPS 100000
+#define MAX_PAYLOAD 14
+
+static std::mt19937 rng(2024);
+static const char alphabet[] = " \t\r\n+-.0123456789abcdefxXONFonf";
+
+static std::string randomPayload() {
+  std::string payload;
+  size_t length = rng() % (MAX_PAYLOAD + 1);
+
+  for (size_t i = 0; i < length; i++)
+  {
+    payload += alphabet[rng() % (sizeof(alphabet) - 1)];
+  }
+  return payload;
+}
+
+// The payload trimmed like parseArgument() does
+static std::string trimmed(const std::string &payload) {
+  size_t start = payload.find_first_not_of(" \t");
+  if (start == std::string::npos)
+    return "";
+  size_t end = payload.find_last_not_of(" \t\r\n");
+  return end == std::string::npos || end < start ? "" : payload.substr(start, end - start + 1);
+}
+
+static bool reference(commandArgument argument, const std::string &payload, int32_t *value) {
+  static const std::regex hex("(0[xX])?([0-9a-fA-F]{1,4})");
+  static const std::regex integer("([+-]?)([0-9]{1,9})");
+  static const std::regex tenths("([+-]?)([0-9]{1,9})(\\.([0-9]?))?");
+  std::string text = trimmed(payload);
+  std::string upper = text;
+  std::smatch match;
+
+  for (char &c : upper)
+    c = toupper(c);
+  switch (argument)
+  {
+    case argPayload:
+      *value = text.size();
+      return true;
+    case argOnOff:
+      if (upper == "ON" || upper == "1")
+        *value = 1;
+      else if (upper == "OFF" || upper == "0")
+        *value = 0;
+      else
+        return false;
+      return true;
+    case argHex:
+      if (!std::regex_match(text, match, hex))
+        return false;
+      *value = strtol(match[2].str().c_str(), NULL, 16);
+      return true;
+    case argInteger:
+      if (!std::regex_match(text, match, integer))
+        return false;
+      *value = atol(match[2].str().c_str()) * (match[1] == "-" ? -1 : 1);
+      return true;
+    case argTenths:
+      if (!std::regex_match(text, match, tenths))
+        return false;
+      *value = atol(match[2].str().c_str()) * 10 + (match[4].length() ? match[4].str()[0] - '0' : 0);
+      *value *= match[1] == "-" ? -1 : 1;
+      return true;
+  }
+  return false;
+}
+
+static void fuzz(commandArgument argument) {
+  uint8_t memory[MAX_PAYLOAD + 8];
+  uint32_t accepted = 0;
+
+  for (uint32_t i = 0; i < FUZZ_PAYLOADS; i++)
+  {
+    std::string payload = randomPayload();
+    int32_t expected = 0x5A5A5A5A, value = 0x5A5A5A5A;
+
+    memset(memory, '7', sizeof(memory));
+    memcpy(memory, payload.data(), payload.size());
+    bool ok = reference(argument, payload, &expected);
+    TEST_ASSERT_EQUAL_MESSAGE(ok, parseArgument(argument, memory, payload.size(), &value), payload.c_str());
+    if (ok)
+    {
+      TEST_ASSERT_EQUAL_MESSAGE(expected, value, payload.c_str());
+      accepted++;
+    }
+  }
+  printf("argument %u: %lu of %u payloads accepted\n", (unsigned)argument, (unsigned long)accepted, FUZZ_PAYLOADS);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_known_payloads() {
+  int32_t value;
+
+  TEST_ASSERT_TRUE(parseArgument(argTenths, (const uint8_t *)" 80.5\r\n", 7, &value));
+  TEST_ASSERT_EQUAL(805, value);
+  TEST_ASSERT_TRUE(parseArgument(argTenths, (const uint8_t *)"-3", 2, &value));
+  TEST_ASSERT_EQUAL(-30, value);
+  TEST_ASSERT_TRUE(parseArgument(argHex, (const uint8_t *)"0x0F", 4, &value));
+  TEST_ASSERT_EQUAL(15, value);
+  TEST_ASSERT_TRUE(parseArgument(argOnOff, (const uint8_t *)"off", 3, &value));
+  TEST_ASSERT_EQUAL(0, value);
+  TEST_ASSERT_FALSE(parseArgument(argInteger, (const uint8_t *)"1234567890", 10, &value));
+  TEST_ASSERT_FALSE(parseArgument(argHex, (const uint8_t *)"0x", 2, &value));
+  TEST_ASSERT_FALSE(parseArgument(argInteger, (const uint8_t *)"", 0, &value));
+  TEST_ASSERT_FALSE(parseArgument(argTenths, (const uint8_t *)"1.23", 4, &value));
+}
+
+void test_fuzz_on_off() { fuzz(argOnOff); }
+void test_fuzz_integer() { fuzz(argInteger); }
+void test_fuzz_hex() { fuzz(argHex); }
+void test_fuzz_tenths() { fuzz(argTenths); }
+void test_fuzz_payload() { fuzz(argPayload); }
+
+// tables of 0 to 40 sorted suffixes, looked up with their own suffixes and random near misses
+void test_find_command() {
+  static const char letters[] = "abcdefgh/";
+  std::vector<std::string> suffixes;
+  std::vector<mqttCommand> table;
+
+  for (uint8_t size = 0; size <= 40; size++)
+  {
+    suffixes.clear();
+    while (suffixes.size() < size)
+    {
+      std::string suffix;
+      size_t length = 1 + rng() % 6;
+      for (size_t i = 0; i < length; i++)
+        suffix += letters[rng() % (sizeof(letters) - 1)];
+      if (std::find(suffixes.begin(), suffixes.end(), suffix) == suffixes.end())
+        suffixes.push_back(suffix);
+    }
+    std::sort(suffixes.begin(), suffixes.end());
+    table.clear();
+    for (const std::string &suffix : suffixes)
+      table.push_back({ suffix.c_str(), argInteger, 0, 0, 0, NULL });
+
+    for (uint32_t i = 0; i < FUZZ_LOOKUPS / 40; i++)
+    {
+      std::string suffix = size && rng() % 2 ? suffixes[rng() % size] : "";
+      if (suffix.empty() || rng() % 2)
+        suffix += letters[rng() % (sizeof(letters) - 1)];
+      const mqttCommand *expected = NULL;
+      for (const mqttCommand &command : table)
+        if (suffix == command.suffix)
+          expected = &command;
+      TEST_ASSERT_EQUAL_PTR(expected, findCommand(table.data(), table.size(), suffix.c_str()));
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_known_payloads);
+  RUN_TEST(test_fuzz_on_off);
+  RUN_TEST(test_fuzz_integer);
+  RUN_TEST(test_fuzz_hex);
+  RUN_TEST(test_fuzz_tenths);
+  RUN_TEST(test_fuzz_payload);
+  RUN_TEST(test_find_command);
+  return UNITY_END();
+}
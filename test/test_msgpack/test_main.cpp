@@ -0,0 +1,99 @@
+// The MessagePack data message against the JSON one, both from the same read of the simulated inverter:
+// the values agree, and the sizes and the host CPU time of the two encodings are printed.
+// Built with PUBLISH_MSGPACK only: pio test -e native-msgpack
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+
+#ifndef PUBLISH_MSGPACK
+#error "test_msgpack needs PUBLISH_MSGPACK, see env:native-msgpack"
+#endif
+
+#define ENCODE_ROUNDS 20000
+#define MSGPACK_DOCUMENT_SIZE JSON_OBJECT_SIZE(INPUT_REGISTER_COUNT)
+
+growattSimulator simulator(slaveIds, INVERTERS);
+growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+static char json[1024];
+static uint8_t msgpack[1024];
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static size_t encodeJson() {
+  jsonWriter writer(json, sizeof(json));
+
+  growatt.InputRegistersToJson(0, writer);
+  TEST_ASSERT_FALSE(writer.overflow());
+  return writer.length();
+}
+
+static size_t encodeMsgPack() {
+  StaticJsonDocument<MSGPACK_DOCUMENT_SIZE> doc;
+
+  growatt.InputRegistersToDocument(0, doc.to<JsonObject>());
+  TEST_ASSERT_FALSE(doc.overflowed());
+  return serializeMsgPack(doc, msgpack, sizeof(msgpack));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_same_values() {
+  DynamicJsonDocument fromJson(4096);
+  DynamicJsonDocument fromMsgPack(4096);
+
+  growatt.SelectInputSnapshot(0);
+  size_t jsonLength = encodeJson();
+  size_t msgpackLength = encodeMsgPack();
+  TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(fromJson, json, jsonLength).code());
+  TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeMsgPack(fromMsgPack, msgpack, msgpackLength).code());
+  TEST_ASSERT_EQUAL(fromJson.size(), fromMsgPack.size());
+  for (JsonPair field : fromJson.as<JsonObject>())
+  {
+    JsonVariant value = fromMsgPack[field.key()];
+    TEST_ASSERT_FALSE(value.isNull());
+    // the JSON text has the published decimals, the float the value of the register
+    TEST_ASSERT_TRUE_MESSAGE(fabs(field.value().as<double>() - value.as<double>()) < 0.001, field.key().c_str());
+  }
+}
+
+void test_size_and_time() {
+  size_t jsonLength = 0;
+  size_t msgpackLength = 0;
+
+  growatt.SelectInputSnapshot(0);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ENCODE_ROUNDS; i++)
+  {
+    jsonLength = encodeJson();
+  }
+  double jsonUs = elapsedUs(start) / ENCODE_ROUNDS;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ENCODE_ROUNDS; i++)
+  {
+    msgpackLength = encodeMsgPack();
+  }
+  double msgpackUs = elapsedUs(start) / ENCODE_ROUNDS;
+
+  printf("data message, %u fields: JSON %u bytes in %.2f us, MessagePack %u bytes in %.2f us\n",
+         (unsigned)INPUT_REGISTER_COUNT, (unsigned)jsonLength, jsonUs, (unsigned)msgpackLength, msgpackUs);
+  TEST_ASSERT_LESS_THAN(jsonLength, msgpackLength);
+}
+
+int main() {
+  growatt.initGrowatt(simulator);
+  growatt.beginReadInputRegisters(0);
+  while (!growatt.done())
+  {
+    growatt.poll();
+    nativeAdvance(100);
+  }
+  UNITY_BEGIN();
+  RUN_TEST(test_same_values);
+  RUN_TEST(test_size_and_time);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+// The store of snapshots read during a broker outage: oldest first out, the oldest dropped when it is full, the
+// drain rate after the reconnect on the simulated clock, OFFLINE_DRAIN_BATCH snapshots per OFFLINE_DRAIN_INTERVAL,
+// and the published snapshots kept until their PUBACK.
+#include <unity.h>
+#include "offlineStore.h"
+
+#define STEP 10                   // ms of simulated time between two loop() passes
+
+static offlineStore store;
+static uint32_t publishedTimes[2 * OFFLINE_RECORDS];
+static uint16_t publishedCount;
+static uint16_t failAfter;        // publish() fails from this call on
+
+static bool publish(const storedSnapshot &record) {
+  if (publishedCount >= failAfter)
+    return false;
+  publishedTimes[publishedCount++] = record.time;
+  return true;
+}
+
+static void fill(uint16_t records, uint32_t first = 0) {
+  storedSnapshot record = {};
+
+  for (uint16_t i = 0; i < records; i++)
+  {
+    record.time = first + i;
+    record.words[0] = i;
+    store.push(record);
+  }
+}
+
+void setUp() {
+  store.resend();
+  while (store.size())
+    store.pop();
+  store.droppedSnapshots();
+  publishedCount = 0;
+  failAfter = 0xFFFF;
+}
+void tearDown() {}
+
+void test_full_store_drops_oldest() {
+  storedSnapshot record;
+
+  fill(OFFLINE_RECORDS + 6);
+  TEST_ASSERT_EQUAL(OFFLINE_RECORDS, store.size());
+  TEST_ASSERT_EQUAL(6, store.droppedSnapshots());
+  TEST_ASSERT_EQUAL(0, store.droppedSnapshots());
+  TEST_ASSERT_TRUE(store.oldest(record));
+  TEST_ASSERT_EQUAL(6, record.time);
+  TEST_ASSERT_EQUAL(6, record.words[0]);
+}
+
+// a full store goes out in OFFLINE_RECORDS / OFFLINE_DRAIN_BATCH passes, one per interval, oldest first
+void test_drain_rate() {
+  uint32_t start = millis();
+  uint32_t firstPass = 0;
+  uint16_t passes = 0;
+
+  fill(OFFLINE_RECORDS);
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  while (store.size())
+  {
+    uint8_t published = store.drain(publish);
+    TEST_ASSERT_LESS_OR_EQUAL(OFFLINE_DRAIN_BATCH, published);
+    store.acknowledge(published);
+    if (published)
+    {
+      if (passes++ == 0)
+        firstPass = millis();
+    }
+    nativeAdvance(STEP * 1000UL);
+    TEST_ASSERT_LESS_THAN(60000, millis() - start);
+  }
+  uint32_t drainTime = millis() - firstPass;
+  printf("%u snapshots in %u passes, %lu ms: %.1f snapshots/s\n", OFFLINE_RECORDS, passes,
+         (unsigned long)drainTime, OFFLINE_RECORDS * 1000.0 / (drainTime + OFFLINE_DRAIN_INTERVAL));
+  TEST_ASSERT_EQUAL(OFFLINE_RECORDS, publishedCount);
+  TEST_ASSERT_EQUAL((OFFLINE_RECORDS + OFFLINE_DRAIN_BATCH - 1) / OFFLINE_DRAIN_BATCH, passes);
+  TEST_ASSERT_GREATER_OR_EQUAL((passes - 1) * OFFLINE_DRAIN_INTERVAL, drainTime);
+  TEST_ASSERT_LESS_THAN((passes - 1) * (OFFLINE_DRAIN_INTERVAL + STEP) + STEP, drainTime);
+  for (uint16_t i = 0; i < publishedCount; i++)
+  {
+    TEST_ASSERT_EQUAL(i, publishedTimes[i]);
+  }
+}
+
+// a snapshot the client did not take stays first in the store for the next pass
+void test_publish_fails() {
+  storedSnapshot record;
+
+  fill(20);
+  failAfter = 3;
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(3, store.drain(publish));
+  store.acknowledge(3);
+  TEST_ASSERT_EQUAL(17, store.size());
+  TEST_ASSERT_TRUE(store.oldest(record));
+  TEST_ASSERT_EQUAL(3, record.time);
+
+  failAfter = 0xFFFF;
+  TEST_ASSERT_EQUAL(0, store.drain(publish));       // before the interval
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(OFFLINE_DRAIN_BATCH, store.drain(publish));
+  TEST_ASSERT_EQUAL(3, publishedTimes[3]);
+}
+
+// published snapshots stay until their PUBACK, are published again after a reconnect, and a dropped one
+// takes its PUBACK along
+void test_kept_until_acknowledged() {
+  storedSnapshot record;
+
+  fill(10);
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(OFFLINE_DRAIN_BATCH, store.drain(publish));
+  store.acknowledge(2);
+  TEST_ASSERT_EQUAL(8, store.size());
+  TEST_ASSERT_TRUE(store.oldest(record));
+  TEST_ASSERT_EQUAL(2, record.time);
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(2, store.drain(publish));       // only the two not yet published
+
+  // the connection was lost: all eight go out again, oldest first
+  store.resend();
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(8, store.drain(publish));
+  for (uint16_t i = 0; i < 8; i++)
+  {
+    TEST_ASSERT_EQUAL(2 + i, publishedTimes[10 + i]);
+  }
+
+  // the full store drops the eight published snapshots, their PUBACKs remove nothing else
+  fill(OFFLINE_RECORDS, 100);
+  TEST_ASSERT_EQUAL(8, store.droppedSnapshots());
+  store.acknowledge(8);
+  TEST_ASSERT_EQUAL(OFFLINE_RECORDS, store.size());
+  TEST_ASSERT_TRUE(store.oldest(record));
+  TEST_ASSERT_EQUAL(100, record.time);
+  nativeAdvance(OFFLINE_DRAIN_INTERVAL * 1000UL);
+  TEST_ASSERT_EQUAL(OFFLINE_DRAIN_BATCH, store.drain(publish));
+  store.acknowledge(1);
+  TEST_ASSERT_TRUE(store.oldest(record));
+  TEST_ASSERT_EQUAL(101, record.time);
+}
+
+int main() {
+  store.begin();
+  UNITY_BEGIN();
+  RUN_TEST(test_full_store_drops_oldest);
+  RUN_TEST(test_drain_rate);
+  RUN_TEST(test_publish_fails);
+  RUN_TEST(test_kept_until_acknowledged);
+  return UNITY_END();
+}
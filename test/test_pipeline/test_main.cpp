@@ -0,0 +1,101 @@
+// Modbus -> JSON pipeline against the simulated inverter: checks that an update arrives complete and
+// prints the host throughput of the stages. The numbers are for comparing builds on one machine.
+#include <unity.h>
+#include <chrono>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+#include "util/crc16.h"
+
+#define PIPELINE_UPDATES 2000
+
+growattSimulator simulator(slaveIds, INVERTERS);
+growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One input register update, the simulated line time passes 100 us per poll()
+static uint8_t readInputs() {
+  growatt.beginReadInputRegisters(0);
+  while (!growatt.done())
+  {
+    growatt.poll();
+    nativeAdvance(100);
+  }
+  return growatt.result();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_update_is_complete() {
+  char json[1024];
+  jsonWriter writer(json, sizeof(json));
+
+  TEST_ASSERT_EQUAL(growattIF::Success, readInputs());
+  growatt.SelectInputSnapshot(0);
+  growatt.InputRegistersToJson(0, writer);
+  TEST_ASSERT_FALSE(writer.overflow());
+  TEST_ASSERT_EQUAL('{', json[0]);
+  TEST_ASSERT_EQUAL('}', json[writer.length() - 1]);
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"pv1voltage\":"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"gridfrequency\":"));
+}
+
+void test_polls_per_second() {
+  uint32_t requests = simulator.requestCount();
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint16_t i = 0; i < PIPELINE_UPDATES; i++)
+  {
+    TEST_ASSERT_EQUAL(growattIF::Success, readInputs());
+  }
+  double us = elapsedUs(start);
+  printf("input updates: %.0f/s host CPU, %.1f us each, %.2f requests each\n",
+         PIPELINE_UPDATES * 1e6 / us, us / PIPELINE_UPDATES,
+         (double)(simulator.requestCount() - requests) / PIPELINE_UPDATES);
+}
+
+void test_crc_cost() {
+  uint8_t frame[133];
+  uint16_t crc = 0xFFFF;
+
+  for (uint16_t i = 0; i < sizeof(frame); i++)
+  {
+    frame[i] = i * 7;
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    crc = crc16_update_block(crc, frame, sizeof(frame));
+  }
+  double us = elapsedUs(start);
+  printf("CRC16: %.1f bytes/us (crc %04X)\n", 100000.0 * sizeof(frame) / us, crc);
+}
+
+void test_json_encoding() {
+  char json[1024];
+  size_t length = 0;
+
+  growatt.SelectInputSnapshot(0);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    jsonWriter writer(json, sizeof(json));
+    growatt.InputRegistersToJson(0, writer);
+    length = writer.length();
+  }
+  double us = elapsedUs(start);
+  printf("data message: %u bytes in %.2f us\n", (unsigned)length, us / 100000);
+}
+
+int main() {
+  growatt.initGrowatt(simulator);
+  UNITY_BEGIN();
+  RUN_TEST(test_update_is_complete);
+  RUN_TEST(test_polls_per_second);
+  RUN_TEST(test_crc_cost);
+  RUN_TEST(test_json_encoding);
+  return UNITY_END();
+}
@@ -0,0 +1,185 @@
+// The register map decoder against response frames in the layout of the former hand-written decoder
+// (two reads of 64 registers from 0 and 64, input and holding), with the values it published for them.
+// The one difference is deratingmode: it read register 103, the low word of opfullpower, the map reads 104.
+#include <unity.h>
+#include "growattInterface.h"
+#include "util/crc16.h"
+
+// Responses of slave 1 with daytime values, CRC included
+static const uint8_t input0[] = {
+  0x01, 0x04, 0x80, 0x00, 0x01, 0x00, 0x00, 0x5B, 0xA0, 0x0C, 0x34, 0x00, 0x29, 0x00, 0x00, 0x32,
+  0x08, 0x0B, 0xEA, 0x00, 0x24, 0x00, 0x00, 0x2A, 0xE4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x59, 0x56, 0x13, 0x86, 0x09,
+  0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x8F, 0x00, 0x01, 0xE2, 0x40, 0x00, 0x23, 0xCA, 0xCE, 0x00, 0x00, 0x00, 0x4D, 0x00, 0x00, 0xFF,
+  0x98, 0x00, 0x00, 0x11, 0xAB
+};
+static const uint8_t input64[] = {
+  0x01, 0x04, 0x80, 0x00, 0x42, 0x00, 0x00, 0xE2, 0xA8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x9C, 0x01,
+  0x8E, 0x01, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x27, 0x10, 0x00, 0x64, 0x00,
+  0x00, 0x75, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x92, 0xEE
+};
+static const uint8_t holding0[] = {
+  0x01, 0x03, 0x80, 0x00, 0x01, 0x00, 0x4D, 0x00, 0x00, 0x00, 0x64, 0x00, 0xFF, 0x00, 0x00, 0x00,
+  0x00, 0x75, 0x30, 0x0E, 0x10, 0x44, 0x4F, 0x31, 0x2E, 0x30, 0x20, 0x5A, 0x41, 0x41, 0x41, 0x30,
+  0x30, 0x00, 0x00, 0x00, 0x00, 0x03, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x42, 0x43, 0x45, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x30, 0x0A, 0x50, 0x12,
+  0x8E, 0x14, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x7B, 0x28
+};
+static const uint8_t holding64[] = {
+  0x01, 0x03, 0x80, 0x07, 0x9E, 0x09, 0xE2, 0x12, 0xC0, 0x13, 0xBA, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x2E, 0x6A
+};
+
+static const char inputJson[] = "{\"status\":1,\"solarpower\":2345.6,\"pv1voltage\":312.4,\"pv1current\":4.1,\"pv1power\":1280.8,"
+  "\"pv2voltage\":305.0,\"pv2current\":3.6,\"pv2power\":1098.0,\"outputpower\":2287.0,\"gridfrequency\":49.98,"
+  "\"gridvoltage\":231.7,\"energytoday\":14.3,\"energytotal\":12345.6,\"totalworktime\":1172839.0,"
+  "\"pv1energytoday\":7.7,\"pv1energytotal\":6543.2,\"pv2energytoday\":6.6,\"pv2energytotal\":5802.4,"
+  "\"opfullpower\":3000.0,\"tempinverter\":41.2,\"tempipm\":39.8,\"tempboost\":38.5,\"ipf\":10000,"
+  "\"realoppercent\":100,\"deratingmode\":0,\"faultcode\":0,\"faultbitcode\":0,\"warningbitcode\":1}";
+
+static const char holdingJson[] = "{\"enable\":1,\"safetyfuncen\":77,\"maxoutputactivepp\":100,\"maxoutputreactivepp\":255,"
+  "\"maxpower\":3000.0,\"voltnormal\":360.0,\"startvoltage\":80.0,\"gridvoltlowlimit\":184.0,\"gridvolthighlimit\":264.0,"
+  "\"gridfreqlowlimit\":47.5,\"gridfreqhighlimit\":51.5,\"gridvoltlowconnlimit\":195.0,\"gridvolthighconnlimit\":253.0,"
+  "\"gridfreqlowconnlimit\":48.0,\"gridfreqhighconnlimit\":50.5,\"firmware\":\"DO1.0 \",\"controlfirmware\":\"ZAAA00\","
+  "\"serial\":\"BCE1234567\",\"modulPower\":\"001E\"}";
+
+// Answers each read with the requested registers cut from the frames that hold them, under a new CRC,
+// since the read plan of the map does not ask for the same blocks
+class frameReplay : public Stream {
+  private:
+    uint8_t request[8];
+    uint8_t requestLength = 0;
+    uint8_t response[256];
+    uint16_t responseLength = 0;
+    uint16_t responseIndex = 0;
+
+    const uint8_t *frame(uint8_t function, uint16_t reg) {
+      const uint8_t *frames[] = { input0, input64, holding0, holding64 };
+      return frames[(function == 0x03 ? 2 : 0) + reg / 64];
+    }
+
+    void answer() {
+      uint8_t function = request[1];
+      uint16_t start = request[2] << 8 | request[3];
+      uint16_t count = request[4] << 8 | request[5];
+      uint16_t crc;
+
+      responseIndex = 0;
+      responseLength = 0;
+      if ((function != 0x03 && function != 0x04) || count == 0 || start + count > 128)
+        return;
+      response[0] = request[0];
+      response[1] = function;
+      response[2] = 2 * count;
+      for (uint16_t i = 0; i < count; i++)
+      {
+        memcpy(response + 3 + 2 * i, frame(function, start + i) + 3 + 2 * ((start + i) % 64), 2);
+      }
+      crc = crc16_update_block(0xFFFF, response, 3 + 2 * count);
+      response[3 + 2 * count] = crc & 0xFF;
+      response[4 + 2 * count] = crc >> 8;
+      responseLength = 5 + 2 * count;
+    }
+
+  public:
+    bool corrupt = false;           // flip a bit of the next response
+
+    size_t write(uint8_t data) override {
+      request[requestLength++] = data;
+      if (requestLength == sizeof(request))
+      {
+        requestLength = 0;
+        answer();
+        if (corrupt && responseLength)
+        {
+          response[5] ^= 0x01;
+          corrupt = false;
+        }
+      }
+      return 1;
+    }
+    using Print::write;
+    int available() override { return responseLength - responseIndex; }
+    int read() override { return responseIndex < responseLength ? response[responseIndex++] : -1; }
+    int peek() override { return responseIndex < responseLength ? response[responseIndex] : -1; }
+};
+
+frameReplay line;
+growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+
+void setUp() {}
+void tearDown() {}
+
+void test_frames_are_valid() {
+  const uint8_t *frames[] = { input0, input64, holding0, holding64 };
+
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    TEST_ASSERT_EQUAL_HEX16(0, crc16_update_block(0xFFFF, frames[i], 3 + 128 + 2));
+  }
+}
+
+void test_input_registers() {
+  char json[1024];
+  jsonWriter writer(json, sizeof(json));
+
+  // every group has been read after the slowest divider
+  for (uint8_t update = 0; update < registerGroups[grpEnergy].divider; update++)
+  {
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.ReadInputRegisters(0));
+  }
+  growatt.SelectInputSnapshot(0);
+  growatt.InputRegistersToJson(0, writer);
+  TEST_ASSERT_EQUAL_STRING(inputJson, json);
+}
+
+void test_holding_registers() {
+  char json[1024];
+  jsonWriter writer(json, sizeof(json));
+
+  TEST_ASSERT_EQUAL(growattIF::Success, growatt.ReadHoldingRegisters(0));
+  growatt.HoldingRegistersToJson(0, writer);
+  TEST_ASSERT_EQUAL_STRING(holdingJson, json);
+}
+
+// A broken frame is refused and leaves the values of the last good read
+void test_corrupt_frame() {
+  char json[1024];
+  jsonWriter writer(json, sizeof(json));
+
+  line.corrupt = true;
+  TEST_ASSERT_EQUAL(ModbusMaster::ku8MBInvalidCRC, growatt.ReadHoldingRegisters(0));
+  growatt.HoldingRegistersToJson(0, writer);
+  TEST_ASSERT_EQUAL_STRING(holdingJson, json);
+}
+
+int main() {
+  growatt.initGrowatt(line);
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_are_valid);
+  RUN_TEST(test_input_registers);
+  RUN_TEST(test_holding_registers);
+  RUN_TEST(test_corrupt_frame);
+  return UNITY_END();
+}
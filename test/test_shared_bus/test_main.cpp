@@ -0,0 +1,161 @@
+// Two masters on one bus: the simulated inverter is also read by a datalogger every 1.7 s. Our reads wait for
+// the idle bus and ask again after a response broken by a collision. A silent inverter is no collision: the
+// read fails after one response timeout and is not asked again. A response of the other master is taken into
+// the register image only when it holds a register of the map.
+// Built with MODBUS_SHARED_BUS only: pio test -e native-shared
+#include <unity.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+#include "util/crc16.h"
+
+#ifndef MODBUS_SHARED_BUS
+#error "test_shared_bus needs MODBUS_SHARED_BUS, see env:native-shared"
+#endif
+
+#define UPDATES 2000
+#define POLL_STEP 100             // us of line time per poll()
+#define CHARACTER_TIME 1146       // us of one character at 9600 baud, 11 bits
+#define DATALOGGER_PERIOD 1700    // ms
+
+// Sends our requests at the pace of the line, so the datalogger can start talking into one
+class pacedLine : public Stream {
+  private:
+    growattSimulator &slave;
+
+  public:
+    pacedLine(growattSimulator &_slave) : slave(_slave) {}
+    size_t write(uint8_t data) override {
+      nativeAdvance(CHARACTER_TIME);
+      return slave.write(data);
+    }
+    using Print::write;
+    int available() override { return slave.available(); }
+    int read() override { return slave.read(); }
+    int peek() override { return slave.peek(); }
+};
+
+// The frames of the other master, handed out as they were queued
+class recordedLine : public Stream {
+  private:
+    uint8_t bytes[512];
+    uint16_t length = 0;
+    uint16_t index = 0;
+
+    void appendFrame(const uint8_t *frame, uint16_t size) {
+      uint16_t crc = crc16_update_block(0xFFFF, frame, size);
+
+      memcpy(bytes + length, frame, size);
+      length += size;
+      bytes[length++] = crc & 0xFF;
+      bytes[length++] = crc >> 8;
+    }
+
+  public:
+    // request and response of a register read of the slave, the registers hold their address
+    void read(uint8_t slave, uint8_t function, uint16_t start, uint8_t count) {
+      uint8_t frame[3 + 2 * 32] = { slave, function, (uint8_t)(start >> 8), (uint8_t)start, 0, count };
+
+      appendFrame(frame, 6);
+      frame[2] = 2 * count;
+      for (uint8_t i = 0; i < count; i++)
+      {
+        frame[3 + 2 * i] = (start + i) >> 8;
+        frame[4 + 2 * i] = start + i;
+      }
+      appendFrame(frame, 3 + 2 * count);
+    }
+    size_t write(uint8_t data) override { return 1; }
+    using Print::write;
+    int available() override { return length - index; }
+    int read() override { return index < length ? bytes[index++] : -1; }
+    int peek() override { return index < length ? bytes[index] : -1; }
+};
+
+static const uint8_t otherSlave[] = { 0xF7 };
+growattSimulator simulator(slaveIds, INVERTERS);
+growattSimulator silent(otherSlave, 1);
+pacedLine line(simulator);
+
+// us of line time from the start of the read until it failed or succeeded
+static uint32_t readInputs(growattIF &growatt, uint8_t *result) {
+  uint32_t start = micros();
+
+  growatt.beginReadInputRegisters(0);
+  while (!growatt.done())
+  {
+    growatt.poll();
+    nativeAdvance(POLL_STEP);
+  }
+  *result = growatt.result();
+  return micros() - start;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_two_masters() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+  uint16_t failed = 0;
+  uint8_t result;
+
+  growatt.initGrowatt(line);
+  simulator.setDatalogger(DATALOGGER_PERIOD);
+  for (uint16_t update = 0; update < UPDATES; update++)
+  {
+    readInputs(growatt, &result);
+    if (result != growattIF::Success)
+      failed++;
+    nativeAdvance(1000000 - update * 3333 % 500000);
+  }
+  printf("%u updates beside the datalogger: %u failed, %lu collisions\n",
+         UPDATES, failed, (unsigned long)simulator.collisionCount());
+  TEST_ASSERT_GREATER_THAN(0, simulator.collisionCount());
+  TEST_ASSERT_EQUAL(0, failed);
+}
+
+void test_silent_inverter() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+  uint8_t result;
+
+  growatt.initGrowatt(silent);
+  nativeAdvance(MODBUS_REQUEST_GAP * 1000UL);
+  uint32_t time = readInputs(growatt, &result);
+
+  printf("silent inverter: failed after %lu us\n", (unsigned long)time);
+  TEST_ASSERT_EQUAL(ModbusMaster::ku8MBResponseTimedOut, result);
+  TEST_ASSERT_LESS_THAN(2 * MODBUS_RESPONSE_TIMEOUT * 1000UL, time);
+}
+
+// Reads of the other master beyond the image or between the map fields do not mark the inverter heard, so a listener
+// does not publish its image again for them
+void test_foreign_reads() {
+  growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+  recordedLine other;
+
+  growatt.initGrowatt(other);
+  other.read(slaveIds[0], 0x04, 125, 10);
+  other.read(slaveIds[0], 0x03, 3000, 10);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    growatt.poll();
+  }
+  TEST_ASSERT_EQUAL(0, growatt.heard(false));
+  TEST_ASSERT_EQUAL(0, growatt.heard(true));
+
+  other.read(slaveIds[0], 0x04, 0, 10);
+  other.read(slaveIds[0], 0x03, 0, 10);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    growatt.poll();
+  }
+  TEST_ASSERT_EQUAL(1, growatt.heard(false));
+  TEST_ASSERT_EQUAL(1, growatt.heard(true));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_two_masters);
+  RUN_TEST(test_silent_inverter);
+  RUN_TEST(test_foreign_reads);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+// The write queue against the simulated inverter: a single write takes over the value of the last queued write
+// to its register only when that one is a single write without hold time, so the register ends with the value
+// queued last in every order of single and block writes.
+#include <unity.h>
+#include "growattInterface.h"
+#include "growattSimulator.h"
+
+#define ACTIVE_POWER 3            // maxoutputactivepp
+#define REACTIVE_POWER 4          // maxoutputreactivepp
+
+growattSimulator simulator(slaveIds, INVERTERS);
+growattIF growatt(MAX485_RE_NEG, MAX485_DE, MAX485_RX, MAX485_TX);
+
+// Runs the queued writes like HandleModbus(), returns the number of requests on the bus
+static uint32_t runWrites() {
+  uint32_t requests = simulator.requestCount();
+
+  while (growatt.writesQueued())
+  {
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.beginWrite());
+    while (!growatt.done())
+    {
+      growatt.poll();
+      nativeAdvance(100);
+    }
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.result());
+  }
+  return simulator.requestCount() - requests;
+}
+
+void setUp() {
+  simulator.holdingRegisters[ACTIVE_POWER] = 100;
+  simulator.holdingRegisters[REACTIVE_POWER] = 100;
+}
+void tearDown() {}
+
+// a slider: only the latest value is written
+void test_slider() {
+  for (uint16_t value = 10; value <= 50; value += 10)
+  {
+    TEST_ASSERT_EQUAL(growattIF::Success, growatt.queueWrite(0, ACTIVE_POWER, value));
+  }
+  TEST_ASSERT_EQUAL(1, growatt.writesQueued());
+  TEST_ASSERT_EQUAL(1, runWrites());
+  TEST_ASSERT_EQUAL(50, simulator.holdingRegisters[ACTIVE_POWER]);
+}
+
+// single, block over the register, single: the last single goes behind the block
+void test_block_in_between() {
+  const uint16_t block[] = { 20, 30 };
+
+  growatt.queueWrite(0, ACTIVE_POWER, 10);
+  growatt.queueWrite(0, ACTIVE_POWER, block, 2);
+  growatt.queueWrite(0, ACTIVE_POWER, 40);
+  TEST_ASSERT_EQUAL(3, growatt.writesQueued());
+  runWrites();
+  TEST_ASSERT_EQUAL(40, simulator.holdingRegisters[ACTIVE_POWER]);
+  TEST_ASSERT_EQUAL(30, simulator.holdingRegisters[REACTIVE_POWER]);
+
+  // the block covers the second register only
+  growatt.queueWrite(0, REACTIVE_POWER, 50);
+  growatt.queueWrite(0, ACTIVE_POWER, block, 2);
+  growatt.queueWrite(0, REACTIVE_POWER, 60);
+  TEST_ASSERT_EQUAL(3, growatt.writesQueued());
+  runWrites();
+  TEST_ASSERT_EQUAL(20, simulator.holdingRegisters[ACTIVE_POWER]);
+  TEST_ASSERT_EQUAL(60, simulator.holdingRegisters[REACTIVE_POWER]);
+}
+
+// a write with hold time is kept, and so is the order behind it
+void test_hold_time() {
+  growatt.queueWrite(0, ACTIVE_POWER, 10);
+  growatt.queueWrite(0, ACTIVE_POWER, 20, 50);
+  growatt.queueWrite(0, ACTIVE_POWER, 30);
+  growatt.queueWrite(0, ACTIVE_POWER, 40);
+  TEST_ASSERT_EQUAL(3, growatt.writesQueued());
+  runWrites();
+  TEST_ASSERT_EQUAL(40, simulator.holdingRegisters[ACTIVE_POWER]);
+}
+
+// writes to other registers in between do not stop the coalescing
+void test_other_register() {
+  growatt.queueWrite(0, ACTIVE_POWER, 10);
+  growatt.queueWrite(0, REACTIVE_POWER, 20);
+  growatt.queueWrite(0, ACTIVE_POWER, 30);
+  TEST_ASSERT_EQUAL(2, growatt.writesQueued());
+  runWrites();
+  TEST_ASSERT_EQUAL(30, simulator.holdingRegisters[ACTIVE_POWER]);
+  TEST_ASSERT_EQUAL(20, simulator.holdingRegisters[REACTIVE_POWER]);
+}
+
+// the write on the bus is not changed any more
+void test_write_on_bus() {
+  growatt.queueWrite(0, ACTIVE_POWER, 10);
+  growatt.beginWrite();
+  growatt.poll();
+  growatt.queueWrite(0, ACTIVE_POWER, 20);
+  TEST_ASSERT_EQUAL(2, growatt.writesQueued());
+  while (!growatt.done())
+  {
+    growatt.poll();
+    nativeAdvance(100);
+  }
+  TEST_ASSERT_EQUAL(10, simulator.holdingRegisters[ACTIVE_POWER]);
+  runWrites();
+  TEST_ASSERT_EQUAL(20, simulator.holdingRegisters[ACTIVE_POWER]);
+}
+
+int main() {
+  growatt.initGrowatt(simulator);
+  UNITY_BEGIN();
+  RUN_TEST(test_slider);
+  RUN_TEST(test_block_in_between);
+  RUN_TEST(test_hold_time);
+  RUN_TEST(test_other_register);
+  RUN_TEST(test_write_on_bus);
+  return UNITY_END();
+}